@@ -0,0 +1,603 @@
+// Native benchmark for the detection core.
+//
+//   qr_bench generate <dir> [--count N] [--seed S] [--codes N]
+//       Writes a deterministic corpus of synthetic QR images plus manifest.jsonl.
+//       With --codes, each image holds 1 to N codes with distinct payloads.
+//   qr_bench run <dir> [--iterations N] [--parallel] [--fixed-order] [--gray] [--mean]
+//                [--crop none|png|jpeg|webp|raw] [--reduce N] [--pyramid N] [--tiles]
+//                [--min-code-size N] [--localize] [--rectify] [--json]
+//       Runs every detection entry point over the corpus and reports throughput,
+//       latency percentiles and decode success rate. detectMultipleQRCodes only
+//       succeeds when it finds every code of an image.
+//   qr_bench verify-threshold [--seed S]
+//       Checks MeanAdaptiveThresholds, SIMD rows and tails included, against
+//       exact box sums and cv::adaptiveThreshold for every block size from 3
+//       to 181 on odd and even widths. Exits non-zero on any mismatch.
+//
+// The same seed always produces the same images with a given OpenCV build, so
+// results from before and after a cascade change can be compared directly.
+
+#include "../src/detection.h"
+#include "../src/preprocess.h"
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Degradations applied to one corpus image
+struct ImageParams {
+    int width;
+    int height;
+    int version;            // QR version, 17 + 4 * version modules per side
+    double codeFraction;    // code side relative to the shorter image side
+    double blur;            // Gaussian sigma in pixels, 0 = sharp
+    double noise;           // Gaussian noise standard deviation, 0 = clean
+    double rotation;        // degrees
+    double perspective;     // corner jitter relative to the code side
+    double contrast;        // 1 = full black/white
+    double gamma;
+    int codes;              // codes in the image, each in its own grid cell
+};
+
+// Values each degradation is drawn from; the first entry is the clean case
+static const cv::Size kSizes[] = {{320, 240}, {640, 480}, {1280, 720}, {1920, 1080}};
+static const int kVersions[] = {1, 2, 4, 7, 10};
+static const double kBlurs[] = {0, 0.8, 1.6, 2.5};
+static const double kNoises[] = {0, 6, 14, 24};
+static const double kRotations[] = {0, 5, 15, 30, 45};
+static const double kPerspectives[] = {0, 0.05, 0.12, 0.2};
+static const double kContrasts[] = {1, 0.6, 0.35, 0.2};
+static const double kGammas[] = {1, 0.5, 0.7, 1.5, 2.2};
+
+template <typename T, size_t N>
+static T Pick(cv::RNG& rng, const T (&values)[N]) {
+    return values[rng.uniform(0, static_cast<int>(N))];
+}
+
+// Helper function to draw the parameters of image index from its own RNG stream,
+// so the first N images do not change when the corpus is made larger. The code
+// count is drawn last, and only when maxCodes > 1, so single-code corpora are
+// the same as before it existed.
+static ImageParams DrawParams(uint64_t seed, int index, int maxCodes) {
+    cv::RNG rng(seed * 1000003ULL + static_cast<uint64_t>(index));
+    ImageParams params;
+    cv::Size size = Pick(rng, kSizes);
+    params.width = size.width;
+    params.height = size.height;
+    params.version = Pick(rng, kVersions);
+    params.codeFraction = rng.uniform(0.25, 0.6);
+    params.blur = Pick(rng, kBlurs);
+    params.noise = Pick(rng, kNoises);
+    params.rotation = Pick(rng, kRotations) * (rng.uniform(0, 2) ? 1 : -1);
+    params.perspective = Pick(rng, kPerspectives);
+    params.contrast = Pick(rng, kContrasts);
+    params.gamma = Pick(rng, kGammas);
+    params.codes = maxCodes > 1 ? rng.uniform(1, maxCodes + 1) : 1;
+    return params;
+}
+
+// Payload of code j of image index; the first code keeps the single-code payload
+static std::string Payload(uint64_t seed, int index, int code) {
+    std::string payload = cv::format("QRB-%llu-%05d", static_cast<unsigned long long>(seed), index);
+    return code == 0 ? payload : payload + cv::format("-%d", code);
+}
+
+// Helper function to lay out count codes on a near-square grid of equal cells
+static std::vector<cv::Rect> GridCells(const ImageParams& params, int count) {
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    int rows = (count + columns - 1) / columns;
+    // Portrait images get more rows than columns
+    if (params.height > params.width) {
+        std::swap(columns, rows);
+    }
+    std::vector<cv::Rect> cells;
+    for (int i = 0; i < count; i++) {
+        int column = i % columns;
+        int row = i / columns;
+        cells.push_back(cv::Rect(column * params.width / columns, row * params.height / rows,
+                                 params.width / columns, params.height / rows));
+    }
+    return cells;
+}
+
+// One code placed in the image
+struct PlacedCode {
+    cv::Mat module;                     // rendered code with its quiet zone, side x side
+    cv::Mat transform;                  // code to image perspective transform
+    std::vector<cv::Point2f> corners;   // outer corners of the code in image coordinates
+};
+
+// Helper function to render a code for payload and place it in cell, rotated
+// around the cell center with jittered corners for perspective
+static PlacedCode PlaceCode(const ImageParams& params, const std::string& payload, const cv::Rect& cell,
+                            cv::RNG& rng) {
+    cv::QRCodeEncoder::Params encoderParams;
+    encoderParams.version = params.version;
+    encoderParams.correction_level = cv::QRCodeEncoder::CORRECT_LEVEL_M;
+    cv::Mat code;
+    cv::QRCodeEncoder::create(encoderParams)->encode(payload, code);
+
+    // Quiet zone of four modules on top of whatever border the encoder adds,
+    // then scale to the requested size
+    const int modules = 17 + 4 * params.version;
+    const int border = 4 + std::max(0, (code.cols - modules) / 2);
+    const int quiet = 4;
+    cv::copyMakeBorder(code, code, quiet, quiet, quiet, quiet, cv::BORDER_CONSTANT, cv::Scalar(255));
+    const int total = code.cols;
+    int side = std::max(total, static_cast<int>(std::min(cell.width, cell.height) * params.codeFraction));
+    cv::resize(code, code, cv::Size(side, side), 0, 0, cv::INTER_NEAREST);
+
+    cv::Point2f center(cell.x + cell.width / 2.0f, cell.y + cell.height / 2.0f);
+    double angle = params.rotation * CV_PI / 180.0;
+    double jitter = params.perspective * side;
+    std::vector<cv::Point2f> src = {{0, 0}, {static_cast<float>(side), 0},
+                                    {static_cast<float>(side), static_cast<float>(side)},
+                                    {0, static_cast<float>(side)}};
+    std::vector<cv::Point2f> dst;
+    for (const cv::Point2f& point : src) {
+        double x = point.x - side / 2.0 + rng.uniform(-jitter, jitter);
+        double y = point.y - side / 2.0 + rng.uniform(-jitter, jitter);
+        dst.push_back(cv::Point2f(static_cast<float>(center.x + x * std::cos(angle) - y * std::sin(angle)),
+                                  static_cast<float>(center.y + x * std::sin(angle) + y * std::cos(angle))));
+    }
+
+    PlacedCode placed;
+    placed.module = code;
+    placed.transform = cv::getPerspectiveTransform(src, dst);
+    float inset = static_cast<float>(border) * side / total;
+    float outset = side - inset;
+    std::vector<cv::Point2f> inner = {{inset, inset}, {outset, inset}, {outset, outset}, {inset, outset}};
+    cv::perspectiveTransform(inner, placed.corners, placed.transform);
+    return placed;
+}
+
+// Helper function to render one degraded image holding params.codes codes;
+// corners receives the outer corners of each code in image coordinates
+static cv::Mat RenderImage(const ImageParams& params, uint64_t seed, int index,
+                           std::vector<std::vector<cv::Point2f>>& corners) {
+    cv::RNG rng(seed * 7919ULL + static_cast<uint64_t>(index));
+
+    std::vector<PlacedCode> codes;
+    std::vector<cv::Rect> cells = GridCells(params, params.codes);
+    for (int i = 0; i < params.codes; i++) {
+        codes.push_back(PlaceCode(params, Payload(seed, index, i), cells[i], rng));
+        corners.push_back(codes.back().corners);
+    }
+
+    cv::Mat image(params.height, params.width, CV_8UC1, cv::Scalar(rng.uniform(200, 256)));
+    for (const PlacedCode& code : codes) {
+        cv::warpPerspective(code.module, image, code.transform, image.size(), cv::INTER_LINEAR,
+                            cv::BORDER_TRANSPARENT);
+    }
+
+    // Photometric degradations
+    if (params.contrast != 1) {
+        image.convertTo(image, -1, params.contrast, 128 * (1 - params.contrast));
+    }
+    if (params.gamma != 1) {
+        cv::Mat table(1, 256, CV_8U);
+        for (int i = 0; i < 256; i++) {
+            table.at<uchar>(i) = cv::saturate_cast<uchar>(std::pow(i / 255.0, params.gamma) * 255.0);
+        }
+        cv::LUT(image, table, image);
+    }
+    if (params.blur > 0) {
+        cv::GaussianBlur(image, image, cv::Size(0, 0), params.blur);
+    }
+    if (params.noise > 0) {
+        cv::Mat noise(image.size(), CV_16S);
+        rng.fill(noise, cv::RNG::NORMAL, 0, params.noise);
+        cv::Mat noisy;
+        image.convertTo(noisy, CV_16S);
+        cv::add(noisy, noise, noisy);
+        noisy.convertTo(image, CV_8U);
+    }
+
+    cv::Mat color;
+    cv::cvtColor(image, color, cv::COLOR_GRAY2BGR);
+    return color;
+}
+
+static std::string CornersJson(const std::vector<cv::Point2f>& corners) {
+    std::string json = "[";
+    for (size_t j = 0; j < corners.size(); j++) {
+        json += (j ? "," : "") + cv::format("[%.1f,%.1f]", corners[j].x, corners[j].y);
+    }
+    return json + "]";
+}
+
+static int Generate(const std::string& dir, int count, uint64_t seed, int maxCodes) {
+    std::ofstream manifest(dir + "/manifest.jsonl");
+    if (!manifest) {
+        std::cerr << "Cannot write " << dir << "/manifest.jsonl (does the directory exist?)" << std::endl;
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        ImageParams params = DrawParams(seed, i, maxCodes);
+        std::vector<std::vector<cv::Point2f>> corners;
+        cv::Mat image = RenderImage(params, seed, i, corners);
+
+        std::string file = cv::format("%05d.png", i);
+        if (!cv::imwrite(dir + "/" + file, image)) {
+            std::cerr << "Failed to write " << file << std::endl;
+            return 1;
+        }
+
+        // data and corners describe the first code; payloads and codeCorners list every code
+        manifest << "{\"file\":\"" << file << "\",\"data\":\"" << Payload(seed, i, 0) << "\""
+                 << ",\"codes\":" << params.codes << ",\"payloads\":[";
+        for (int j = 0; j < params.codes; j++) {
+            manifest << (j ? "," : "") << "\"" << Payload(seed, i, j) << "\"";
+        }
+        manifest << "]"
+                 << ",\"width\":" << params.width << ",\"height\":" << params.height
+                 << ",\"version\":" << params.version << ",\"modules\":" << 17 + 4 * params.version
+                 << ",\"codeFraction\":" << cv::format("%.3f", params.codeFraction)
+                 << ",\"blur\":" << params.blur << ",\"noise\":" << params.noise
+                 << ",\"rotation\":" << params.rotation << ",\"perspective\":" << params.perspective
+                 << ",\"contrast\":" << params.contrast << ",\"gamma\":" << params.gamma
+                 << ",\"corners\":" << CornersJson(corners[0]) << ",\"codeCorners\":[";
+        for (size_t j = 0; j < corners.size(); j++) {
+            manifest << (j ? "," : "") << CornersJson(corners[j]);
+        }
+        manifest << "]}\n";
+    }
+
+    std::cout << "Wrote " << count << " images to " << dir << " (seed " << seed << ")" << std::endl;
+    return 0;
+}
+
+// One corpus entry as needed by the runner
+struct CorpusImage {
+    std::string file;
+    std::vector<std::string> payloads;  // every code in the image, the first one first
+    std::vector<uint8_t> bytes;
+};
+
+// Helper function to pull a string field out of a manifest line; the generator
+// never writes quotes inside values
+static std::string StringField(const std::string& line, const std::string& name) {
+    std::string key = "\"" + name + "\":\"";
+    size_t start = line.find(key);
+    if (start == std::string::npos) {
+        return "";
+    }
+    start += key.size();
+    return line.substr(start, line.find('"', start) - start);
+}
+
+// Helper function to pull an array of strings out of a manifest line
+static std::vector<std::string> StringArrayField(const std::string& line, const std::string& name) {
+    std::vector<std::string> values;
+    std::string key = "\"" + name + "\":[";
+    size_t at = line.find(key);
+    if (at == std::string::npos) {
+        return values;
+    }
+    size_t end = line.find(']', at);
+    at += key.size();
+    while ((at = line.find('"', at)) < end) {
+        size_t close = line.find('"', at + 1);
+        values.push_back(line.substr(at + 1, close - at - 1));
+        at = close + 1;
+    }
+    return values;
+}
+
+static bool LoadCorpus(const std::string& dir, std::vector<CorpusImage>& corpus) {
+    std::ifstream manifest(dir + "/manifest.jsonl");
+    if (!manifest) {
+        std::cerr << "Cannot read " << dir << "/manifest.jsonl, run 'qr_bench generate' first" << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        CorpusImage image;
+        image.file = StringField(line, "file");
+        // Corpora written before multi-code scenes only have data
+        image.payloads = StringArrayField(line, "payloads");
+        if (image.payloads.empty()) {
+            image.payloads.push_back(StringField(line, "data"));
+        }
+        std::ifstream file(dir + "/" + image.file, std::ios::binary);
+        image.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (image.bytes.empty()) {
+            std::cerr << "Cannot read " << image.file << std::endl;
+            return false;
+        }
+        corpus.push_back(std::move(image));
+    }
+    return !corpus.empty();
+}
+
+// Latency and success summary for one entry point
+struct BenchResult {
+    std::string name;
+    size_t calls = 0;
+    size_t successes = 0;
+    double wallMs = 0;
+    std::vector<double> latencies;
+};
+
+static double Percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+// Helper function to time fn on every image; fn returns whether the call succeeded.
+// Each call includes image decoding, like the exported functions.
+static BenchResult Measure(const std::string& name, const std::vector<CorpusImage>& corpus, int iterations,
+                           const DetectOptions& options,
+                           const std::function<bool(const DecodedImage&, const CorpusImage&)>& fn) {
+    BenchResult result;
+    result.name = name;
+    auto wallStart = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (const CorpusImage& image : corpus) {
+            ImageSource source;
+            source.data = image.bytes.data();
+            source.size = image.bytes.size();
+            auto start = std::chrono::steady_clock::now();
+            DecodedImage decoded = LoadImage(source, options);
+            bool success = !decoded.pixels.empty() && fn(decoded, image);
+            result.latencies.push_back(ElapsedMs(start));
+            result.calls++;
+            if (success) {
+                result.successes++;
+            }
+        }
+    }
+    result.wallMs = ElapsedMs(wallStart);
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+static void PrintResults(const std::vector<BenchResult>& results, bool json) {
+    if (json) {
+        std::cout << "[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            std::cout << (i ? "," : "") << "{\"function\":\"" << r.name << "\""
+                      << ",\"calls\":" << r.calls
+                      << ",\"successRate\":" << static_cast<double>(r.successes) / std::max<size_t>(1, r.calls)
+                      << ",\"throughput\":" << r.calls / (r.wallMs / 1000.0)
+                      << ",\"p50Ms\":" << Percentile(r.latencies, 50)
+                      << ",\"p90Ms\":" << Percentile(r.latencies, 90)
+                      << ",\"p99Ms\":" << Percentile(r.latencies, 99)
+                      << ",\"maxMs\":" << (r.latencies.empty() ? 0 : r.latencies.back()) << "}";
+        }
+        std::cout << "]" << std::endl;
+        return;
+    }
+
+    std::printf("%-24s %8s %9s %10s %9s %9s %9s %9s\n",
+                "function", "calls", "success", "images/s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (const BenchResult& r : results) {
+        std::printf("%-24s %8zu %8.1f%% %10.1f %9.2f %9.2f %9.2f %9.2f\n",
+                    r.name.c_str(), r.calls, 100.0 * r.successes / std::max<size_t>(1, r.calls),
+                    r.calls / (r.wallMs / 1000.0), Percentile(r.latencies, 50), Percentile(r.latencies, 90),
+                    Percentile(r.latencies, 99), r.latencies.empty() ? 0 : r.latencies.back());
+    }
+}
+
+static int Run(const std::string& dir, int iterations, const DetectOptions& options, bool json) {
+    std::vector<CorpusImage> corpus;
+    if (!LoadCorpus(dir, corpus)) {
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    results.push_back(Measure("detectQRCode", corpus, iterations, options,
+        [&options](const DecodedImage& image, const CorpusImage& expected) {
+            QRCodeResult result;
+            DetectionReport report;
+            return DetectQRCodeInImage(image, options, result, report) &&
+                   std::find(expected.payloads.begin(), expected.payloads.end(), result.data) != expected.payloads.end();
+        }));
+    results.push_back(Measure("detectMultipleQRCodes", corpus, iterations, options,
+        [&options](const DecodedImage& image, const CorpusImage& expected) {
+            DetectionReport report;
+            std::vector<QRCodeResult> results = DetectMultipleQRCodesInImage(image, options, report);
+            for (const std::string& payload : expected.payloads) {
+                if (std::none_of(results.begin(), results.end(),
+                                 [&payload](const QRCodeResult& result) { return result.data == payload; })) {
+                    return false;
+                }
+            }
+            return true;
+        }));
+    results.push_back(Measure("hasQRCode", corpus, iterations, options,
+        [&options](const DecodedImage& image, const CorpusImage&) {
+            std::vector<cv::Point> corners;
+            DetectionReport report;
+            return HasQRCodeInImage(image, options, corners, report);
+        }));
+
+    PrintResults(results, json);
+    return 0;
+}
+
+// Helper function to check MeanAdaptiveThresholds on one random image: every
+// pixel must match the exact box-sum comparison, and may differ from
+// cv::adaptiveThreshold (ADAPTIVE_THRESH_MEAN_C) only where the pixel is within
+// one gray level of the exact mean, since OpenCV compares against the mean
+// rounded to 8 bits. Returns the number of mismatches.
+static size_t VerifyThresholdImage(cv::RNG& rng, int width, int height, const std::vector<int>& blockSizes,
+                                   int delta) {
+    cv::Mat gray(height, width, CV_8UC1);
+    rng.fill(gray, cv::RNG::UNIFORM, 0, 256);
+    // Smooth half of the images so many pixels sit close to their local mean
+    if (rng.uniform(0, 2)) {
+        cv::GaussianBlur(gray, gray, cv::Size(0, 0), 3);
+    }
+
+    std::vector<cv::Mat> binaries = MeanAdaptiveThresholds(gray, blockSizes, delta);
+    size_t mismatches = 0;
+    for (size_t k = 0; k < blockSizes.size(); k++) {
+        int blockSize = blockSizes[k];
+        int area = blockSize * blockSize;
+        cv::Mat sums;
+        cv::boxFilter(gray, sums, CV_32S, cv::Size(blockSize, blockSize), cv::Point(-1, -1), false,
+                      cv::BORDER_REPLICATE);
+        cv::Mat opencv;
+        cv::adaptiveThreshold(gray, opencv, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY, blockSize, delta);
+
+        size_t exactErrors = 0;
+        size_t roundingErrors = 0;
+        for (int y = 0; y < height; y++) {
+            const uchar* src = gray.ptr<uchar>(y);
+            const int* sum = sums.ptr<int>(y);
+            const uchar* ours = binaries[k].ptr<uchar>(y);
+            const uchar* theirs = opencv.ptr<uchar>(y);
+            for (int x = 0; x < width; x++) {
+                int64_t scaled = static_cast<int64_t>(src[x] + delta) * area;
+                uchar expected = scaled > sum[x] ? 255 : 0;
+                if (ours[x] != expected) {
+                    exactErrors++;
+                } else if (ours[x] != theirs[x] && std::abs(scaled - sum[x]) > area) {
+                    roundingErrors++;
+                }
+            }
+        }
+        if (exactErrors || roundingErrors) {
+            std::fprintf(stderr, "%dx%d block %d: %zu differ from the exact mean, %zu from OpenCV beyond rounding\n",
+                         width, height, blockSize, exactErrors, roundingErrors);
+        }
+        mismatches += exactErrors + roundingErrors;
+    }
+    return mismatches;
+}
+
+static int VerifyThreshold(uint64_t seed) {
+    std::vector<int> blockSizes;
+    for (int blockSize = 3; blockSize <= 181; blockSize += 2) {
+        blockSizes.push_back(blockSize);
+    }
+    // Widths around the 16-pixel vector width, odd ones and ones narrower than
+    // the largest block; heights cross the 64-row strip boundary
+    static const int kWidths[] = {1, 2, 7, 15, 16, 17, 31, 33, 63, 97, 181, 255, 641};
+    static const int kHeights[] = {1, 5, 63, 65, 130};
+
+    cv::RNG rng(seed);
+    size_t mismatches = 0;
+    size_t images = 0;
+    for (int width : kWidths) {
+        for (int height : kHeights) {
+            mismatches += VerifyThresholdImage(rng, width, height, blockSizes, rng.uniform(0, 20));
+            images++;
+        }
+    }
+    // One block size per call, as the serial cascade builds them
+    for (int blockSize : {3, 11, 31, 181}) {
+        mismatches += VerifyThresholdImage(rng, 203, 131, {blockSize}, 2);
+        images++;
+    }
+
+    std::printf("%zu images, block sizes 3 to 181: %zu mismatches\n", images, mismatches);
+    return mismatches ? 1 : 0;
+}
+
+static void Usage() {
+    std::cerr << "usage: qr_bench generate <dir> [--count N] [--seed S] [--codes N]\n"
+              << "       qr_bench run <dir> [--iterations N] [--parallel] [--fixed-order] [--gray] [--mean]\n"
+              << "                    [--crop none|png|jpeg|webp|raw] [--reduce N] [--pyramid N] [--tiles]\n"
+              << "                    [--min-code-size N] [--localize] [--rectify] [--json]\n"
+              << "       qr_bench verify-threshold [--seed S]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::string(argv[1]) == "verify-threshold") {
+        uint64_t seed = 1;
+        if (argc == 4 && std::string(argv[2]) == "--seed") {
+            seed = std::strtoull(argv[3], nullptr, 10);
+        } else if (argc != 2) {
+            Usage();
+            return 2;
+        }
+        return VerifyThreshold(seed);
+    }
+    if (argc < 3) {
+        Usage();
+        return 2;
+    }
+    std::string command = argv[1];
+    std::string dir = argv[2];
+
+    int count = 200;
+    uint64_t seed = 1;
+    int codes = 1;
+    int iterations = 1;
+    bool json = false;
+    DetectOptions options;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            count = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--codes" && i + 1 < argc) {
+            codes = std::min(16, std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--parallel") {
+            options.parallel = true;
+        } else if (arg == "--gray") {
+            options.grayDecode = true;
+        } else if (arg == "--mean") {
+            options.gaussianThreshold = false;
+        } else if (arg == "--crop" && i + 1 < argc) {
+            std::string format = argv[++i];
+            options.crop.format = format == "none" ? CropFormat::None :
+                                  format == "jpeg" ? CropFormat::JPEG : format == "webp" ? CropFormat::WebP :
+                                  format == "raw" ? CropFormat::Raw : CropFormat::PNG;
+        } else if (arg == "--reduce" && i + 1 < argc) {
+            options.reduction = std::atoi(argv[++i]);
+        } else if (arg == "--pyramid" && i + 1 < argc) {
+            options.pyramid = std::atoi(argv[++i]);
+        } else if (arg == "--tiles") {
+            options.tiled = true;
+        } else if (arg == "--min-code-size" && i + 1 < argc) {
+            options.minCodeSize = std::min(4096, std::max(8, std::atoi(argv[++i])));
+        } else if (arg == "--localize") {
+            options.localize = true;
+        } else if (arg == "--rectify") {
+            options.rectify = true;
+            options.localize = true;
+        } else if (arg == "--fixed-order") {
+            options.adaptiveOrder = false;
+        } else if (arg == "--json") {
+            json = true;
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+
+    if (command == "generate") {
+        return Generate(dir, count, seed, codes);
+    }
+    if (command == "run") {
+        return Run(dir, iterations, options, json);
+    }
+    Usage();
+    return 2;
+}
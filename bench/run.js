@@ -0,0 +1,205 @@
+#!/usr/bin/env node
+// Benchmarks the exported functions on a corpus written by `qr_bench generate`.
+//
+//   node bench/run.js [corpusDir] [--iterations N] [--concurrency N]
+//       [--functions a,b] [--options '{"parallel":true}'] [--by blur] [--json]
+//
+// Reports throughput, latency percentiles and decode success rate per function.
+// --by breaks the success rate down by one of the manifest parameters
+// (width, codes, version, blur, noise, rotation, perspective, contrast, gamma).
+// The multi-code functions only succeed when they find every code of an image.
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const detector = require('..');
+
+function parseArgs(argv) {
+  const args = {
+    corpus: path.join(__dirname, 'corpus'),
+    iterations: 1,
+    concurrency: os.cpus().length,
+    functions: null,
+    options: {},
+    by: null,
+    json: false,
+  };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    if (arg === '--iterations') args.iterations = Math.max(1, parseInt(argv[++i], 10));
+    else if (arg === '--concurrency') args.concurrency = Math.max(1, parseInt(argv[++i], 10));
+    else if (arg === '--functions') args.functions = argv[++i].split(',');
+    else if (arg === '--options') args.options = JSON.parse(argv[++i]);
+    else if (arg === '--by') args.by = argv[++i];
+    else if (arg === '--json') args.json = true;
+    else if (!arg.startsWith('--')) args.corpus = arg;
+    else throw new Error(`Unknown argument ${arg}`);
+  }
+  return args;
+}
+
+function loadCorpus(dir) {
+  const manifest = path.join(dir, 'manifest.jsonl');
+  if (!fs.existsSync(manifest)) {
+    throw new Error(`${manifest} not found, run "npm run bench:corpus" first`);
+  }
+  return fs.readFileSync(manifest, 'utf8')
+    .split('\n')
+    .filter(Boolean)
+    .map((line) => {
+      const entry = JSON.parse(line);
+      entry.buffer = fs.readFileSync(path.join(dir, entry.file));
+      // Corpora written before multi-code scenes only have data
+      entry.payloads = entry.payloads || [entry.data];
+      return entry;
+    });
+}
+
+// How each function is called and what counts as a success for it
+const FUNCTIONS = {
+  detectQRCodeSync: {
+    call: (input, options) => detector.detectQRCodeSync(input, options),
+    success: (result, entry) => result.detected && entry.payloads.includes(result.data),
+  },
+  detectMultipleQRCodesSync: {
+    call: (input, options) => detector.detectMultipleQRCodesSync(input, options),
+    success: (result, entry) => entry.payloads.every((data) => result.qrCodes.some((code) => code.data === data)),
+  },
+  hasQRCodeSync: {
+    call: (input, options) => detector.hasQRCodeSync(input, options),
+    success: (result) => result.hasQRCode,
+  },
+  detectQRCode: {
+    async: true,
+    call: (input, options) => detector.detectQRCode(input, options),
+    success: (result, entry) => result.detected && entry.payloads.includes(result.data),
+  },
+  detectMultipleQRCodes: {
+    async: true,
+    call: (input, options) => detector.detectMultipleQRCodes(input, options),
+    success: (result, entry) => entry.payloads.every((data) => result.qrCodes.some((code) => code.data === data)),
+  },
+  hasQRCode: {
+    async: true,
+    call: (input, options) => detector.hasQRCode(input, options),
+    success: (result) => result.hasQRCode,
+  },
+};
+
+function nowMs() {
+  return Number(process.hrtime.bigint()) / 1e6;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  const index = Math.max(0, Math.ceil((p / 100) * sorted.length) - 1);
+  return sorted[Math.min(sorted.length - 1, index)];
+}
+
+// Runs every corpus image through fn; async functions keep `concurrency` calls
+// in flight, so their latencies include time queued in the worker pool.
+async function measure(name, fn, corpus, args) {
+  const samples = [];
+  const jobs = [];
+  for (let i = 0; i < args.iterations; i++) jobs.push(...corpus);
+
+  const runOne = async (entry) => {
+    const start = nowMs();
+    let ok = false;
+    try {
+      ok = Boolean(fn.success(await fn.call(entry.buffer, args.options), entry));
+    } catch (err) {
+      ok = false;
+    }
+    samples.push({ entry, ms: nowMs() - start, ok });
+  };
+
+  const wallStart = nowMs();
+  if (fn.async) {
+    let next = 0;
+    const lanes = Array.from({ length: Math.min(args.concurrency, jobs.length) }, async () => {
+      while (next < jobs.length) {
+        await runOne(jobs[next++]);
+      }
+    });
+    await Promise.all(lanes);
+  } else {
+    for (const entry of jobs) {
+      await runOne(entry);
+    }
+  }
+  const wallMs = nowMs() - wallStart;
+
+  const latencies = samples.map((s) => s.ms).sort((a, b) => a - b);
+  const successes = samples.filter((s) => s.ok).length;
+  const result = {
+    function: name,
+    calls: samples.length,
+    successRate: successes / Math.max(1, samples.length),
+    throughput: samples.length / (wallMs / 1000),
+    p50Ms: percentile(latencies, 50),
+    p90Ms: percentile(latencies, 90),
+    p99Ms: percentile(latencies, 99),
+    maxMs: latencies[latencies.length - 1] || 0,
+  };
+
+  if (args.by) {
+    const groups = {};
+    for (const sample of samples) {
+      const key = String(sample.entry[args.by]);
+      groups[key] = groups[key] || { calls: 0, successes: 0 };
+      groups[key].calls++;
+      if (sample.ok) groups[key].successes++;
+    }
+    result.by = {};
+    for (const key of Object.keys(groups).sort((a, b) => Number(a) - Number(b))) {
+      result.by[key] = groups[key].successes / groups[key].calls;
+    }
+  }
+  return result;
+}
+
+function printResults(results, args) {
+  const pad = (value, width) => String(value).padStart(width);
+  console.log(`${'function'.padEnd(26)}${pad('calls', 8)}${pad('success', 10)}${pad('images/s', 10)}` +
+    `${pad('p50 ms', 10)}${pad('p90 ms', 10)}${pad('p99 ms', 10)}${pad('max ms', 10)}`);
+  for (const r of results) {
+    console.log(`${r.function.padEnd(26)}${pad(r.calls, 8)}${pad((r.successRate * 100).toFixed(1) + '%', 10)}` +
+      `${pad(r.throughput.toFixed(1), 10)}${pad(r.p50Ms.toFixed(2), 10)}${pad(r.p90Ms.toFixed(2), 10)}` +
+      `${pad(r.p99Ms.toFixed(2), 10)}${pad(r.maxMs.toFixed(2), 10)}`);
+  }
+
+  if (args.by) {
+    console.log(`\nsuccess rate by ${args.by}`);
+    for (const r of results) {
+      const cells = Object.entries(r.by).map(([key, rate]) => `${key}: ${(rate * 100).toFixed(1)}%`);
+      console.log(`${r.function.padEnd(26)}${cells.join('  ')}`);
+    }
+  }
+}
+
+async function main() {
+  const args = parseArgs(process.argv.slice(2));
+  const corpus = loadCorpus(args.corpus);
+  const names = args.functions || Object.keys(FUNCTIONS);
+
+  const results = [];
+  for (const name of names) {
+    if (!FUNCTIONS[name]) {
+      throw new Error(`Unknown function ${name}, expected one of ${Object.keys(FUNCTIONS).join(', ')}`);
+    }
+    results.push(await measure(name, FUNCTIONS[name], corpus, args));
+  }
+
+  if (args.json) {
+    console.log(JSON.stringify({ corpus: corpus.length, options: args.options, results }, null, 2));
+  } else {
+    console.log(`${corpus.length} images, ${args.iterations} iteration(s), options ${JSON.stringify(args.options)}\n`);
+    printResults(results, args);
+  }
+}
+
+main().catch((err) => {
+  console.error(err.message);
+  process.exit(1);
+});
@@ -3,7 +3,15 @@
         "target_name": "qr_code_detector",
         "cflags!": ["-fno-exceptions"],
         "cflags_cc!": ["-fno-exceptions", "-fno-rtti"],
-        "sources": ["src/qr_code_detector.cpp"],
+        "sources": [
+            "src/qr_code_detector.cpp",
+            "src/detection.cpp",
+            "src/preprocess.cpp",
+            "src/base64.cpp",
+            "src/worker_pool.cpp",
+            "src/cascade_stats.cpp",
+            "src/metrics.cpp"
+        ],
         "include_dirs": [
             "<!@(node -p \"require('node-addon-api').include\")",
             "/usr/local/include/opencv4",
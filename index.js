@@ -1,49 +1,126 @@
-// Load native addon directly (synchronous version to avoid worker thread protobuf conflicts)
-const { 
-  detectQRCode: nativeDetectQRCode, 
+const fs = require('fs');
+
+// Load native addon. The *Async variants decode and detect on the addon's own
+// worker pool and return promises; the plain variants run synchronously on the calling thread.
+const {
+  detectQRCode: nativeDetectQRCode,
   detectMultipleQRCodes: nativeDetectMultipleQRCodes,
-  hasQRCode: nativeHasQRCode 
+  hasQRCode: nativeHasQRCode,
+  detectQRCodeAsync: nativeDetectQRCodeAsync,
+  detectMultipleQRCodesAsync: nativeDetectMultipleQRCodesAsync,
+  hasQRCodeAsync: nativeHasQRCodeAsync,
+  configurePool: nativeConfigurePool,
+  getPoolStats: nativeGetPoolStats,
+  getCascadeStats,
+  setCascadeStats,
+  resetCascadeStats,
+  setPipeline: nativeSetPipeline,
+  encodeQRCodeImage: nativeEncodeQRCodeImage,
+  getMetrics: nativeGetMetrics,
+  OVERLOADED_ERROR_CODE,
 } = require('./build/Release/qr_code_detector');
 
 /**
  * Detects and decodes a single QR code in an image.
- * Note: This is a synchronous operation that wraps the native function in a promise.
- * @param {string|Buffer} input - Image file path or buffer containing image data
+ * Decoding and detection run on the native worker pool and do not block the event loop.
+ * Rejects with an error whose code is OVERLOADED_ERROR_CODE when the pool queue is full.
+ * @param {string|Buffer|Object} input - Image file path, buffer containing image data,
+ *   or raw pixel frame { data, width, height, stride, format }
+ * @param {Object} [options] - Detection options:
+ *   - parallel {boolean} - Evaluate the preprocessing cascade variants concurrently across cores.
+ *     The earliest variant in cascade order that decodes wins, so results match serial mode.
+ *   - order {'adaptive'|'fixed'} - Try variants in order of observed hit rate per unit cost
+ *     (default), or always in the built-in order for reproducible results.
+ *   - timeoutMs {number} - Stop starting new preprocessing attempts after this many milliseconds
+ *   - maxAttempts {number} - Maximum number of decode attempts, including the unprocessed image
+ *     When either budget is set the result also carries timedOut {boolean} and methodsTried {string[]}.
+ *   - stats {boolean} - Add a `stats` object with per-stage timings to the result
+ *   - decode {'color'|'gray'} - Decode only luma with 'gray', skipping chroma work (default: 'color')
+ *   - reduce {1|2|4|8} - Decode at a fraction of the resolution, for large images with large codes
+ *   - cropImage {false|'png'|'jpeg'|'webp'|'raw'} - Return the padded code region as qrCodeImage,
+ *     a data URL in the given format or raw pixels, false for no crop (default: 'png'; deprecated,
+ *     the default becomes false in the next major version, so set it explicitly)
+ *   - cropQuality {number} - JPEG / WebP quality, 0-100 (default: 90)
+ *   - cropCompression {number} - PNG compression level, 0-9 (default: 9)
+ *   - cropBuffer {boolean} - Return qrCodeImage as a Buffer of the encoded image, without
+ *     copying it, instead of a base64 data URL (default: false)
+ *   - cropHandle {boolean} - Add a cropHandle to encode the crop later with encodeQRCodeImage()
+ *   - cropColor {boolean} - Cut qrCodeImage from a full-resolution color decode made only on a hit
+ *   - gammas {number[]} - Gamma correction steps of the cascade, 0.01 to 100 (default: [0.5, 0.7, 1.5, 2.0])
+ *   - threshold {'gaussian'|'mean'} - Local mean used by the adaptive thresholds (default: 'gaussian')
+ *   - pipeline {Array<Object>|null} - Preprocessing steps to try instead of the built-in cascade,
+ *     see setPipeline(); null uses the built-in cascade even when setPipeline() was called
+ *   - localize {boolean} - Locate the code once with detect(), then decode the preprocessing
+ *     variants of the region around it at the located corners; the whole image is still scanned
+ *     if that misses (default: false)
+ *   - rectify {boolean} - As localize, but straighten the located code into a small patch at
+ *     5 pixels per module first and run every variant on that patch (default: false)
+ *   - pyramid {0|2|4} - Locate the code on a 1/2 or 1/4 copy first, then decode only the padded
+ *     region around it at full resolution (default: 0, off)
  * @returns {Promise<Object>} Promise resolving to an object containing:
  *   - detected {boolean} - Whether a QR code was detected
  *   - data {string|null} - Decoded QR code data (null if not detected)
  *   - corners {Array<{x: number, y: number}>} - Corner points of the QR code (if detected)
+ *   - qrCodeImage {string|Buffer|Object} - Crop of the code (if detected and cropImage is not false)
+ *   - cropHandle {Object} - Handle for encodeQRCodeImage() (if detected and cropHandle is set)
  */
-async function detectQRCode(input) {
-  return Promise.resolve(nativeDetectQRCode(input));
+async function detectQRCode(input, options) {
+  return nativeDetectQRCodeAsync(input, options);
 }
 
 /**
- * Detects and decodes multiple QR codes in an image.
- * Note: This is a synchronous operation that wraps the native function in a promise.
- * @param {string|Buffer} input - Image file path or buffer containing image data
+ * Detects and decodes every QR code in an image. Preprocessed variants are scanned while they
+ * still add codes, codes that are located but do not decode get the preprocessing cascade on
+ * a crop around them, and an image where nothing decodes gets the single-code cascade.
+ * Decoding and detection run on the native worker pool and do not block the event loop.
+ * Rejects with an error whose code is OVERLOADED_ERROR_CODE when the pool queue is full.
+ * @param {string|Buffer|Object} input - Image file path, buffer containing image data,
+ *   or raw pixel frame { data, width, height, stride, format }
+ * @param {Object} [options] - Detection options:
+ *   - parallel {boolean} - Evaluate the preprocessing cascade variants concurrently across cores.
+ *     The earliest variant in cascade order that decodes wins, so results match serial mode.
+ *   - order {'adaptive'|'fixed'} - Try variants in order of observed hit rate per unit cost
+ *     (default), or always in the built-in order for reproducible results.
+ *   - timeoutMs {number} - Stop starting new preprocessing attempts after this many milliseconds
+ *   - maxAttempts {number} - Maximum number of decode attempts, including the unprocessed image
+ *     When either budget is set the result also carries timedOut {boolean} and methodsTried {string[]}.
+ *   - stats {boolean} - Add a `stats` object with per-stage timings to the result
+ *   - decode, reduce, cropImage, cropQuality, cropCompression, cropBuffer, cropHandle, cropColor,
+ *     gammas, threshold, pipeline - As for detectQRCode()
+ *   - localize {boolean} - Decode located but undecoded codes at their corners, without
+ *     searching the crop around them again
+ *   - rectify {boolean} - As localize, on a straightened patch of each code
+ *   - tiles {boolean} - Scan overlapping tiles in parallel across cores, for very large images
+ *   - minCodeSize {number} - Smallest expected code side in pixels, used to size the tiles (default: 48)
  * @returns {Promise<Object>} Promise resolving to an object containing:
  *   - detected {boolean} - Whether any QR codes were detected
  *   - count {number} - Number of QR codes detected
  *   - qrCodes {Array<Object>} - Array of detected QR codes, each containing:
  *     - data {string} - Decoded QR code data
  *     - corners {Array<{x: number, y: number}>} - Corner points of the QR code
+ *     - qrCodeImage, cropHandle - As for detectQRCode()
  */
-async function detectMultipleQRCodes(input) {
-  return Promise.resolve(nativeDetectMultipleQRCodes(input));
+async function detectMultipleQRCodes(input, options) {
+  return nativeDetectMultipleQRCodesAsync(input, options);
 }
 
 /**
  * Checks if an image contains a QR code without decoding it.
  * This is faster than detectQRCode() when you only need to know if a QR code is present.
- * Note: This is a synchronous operation that wraps the native function in a promise.
- * @param {string|Buffer} input - Image file path or buffer containing image data
+ * Decoding and detection run on the native worker pool and do not block the event loop.
+ * Rejects with an error whose code is OVERLOADED_ERROR_CODE when the pool queue is full.
+ * @param {string|Buffer|Object} input - Image file path, buffer containing image data,
+ *   or raw pixel frame { data, width, height, stride, format }
+ * @param {Object} [options] - Detection options:
+ *   - stats {boolean} - Add a `stats` object with per-stage timings to the result
+ *   - decode, reduce, pyramid - As for detectQRCode(); with pyramid a code found on the small
+ *     copy answers without a full-resolution scan
  * @returns {Promise<Object>} Promise resolving to an object containing:
  *   - hasQRCode {boolean} - Whether a QR code was detected
  *   - corners {Array<{x: number, y: number}>} - Corner points of the QR code (if detected)
  */
-async function hasQRCode(input) {
-  return Promise.resolve(nativeHasQRCode(input));
+async function hasQRCode(input, options) {
+  return nativeHasQRCodeAsync(input, options);
 }
 
 // Also export synchronous versions
@@ -51,6 +128,87 @@ const detectQRCodeSync = nativeDetectQRCode;
 const detectMultipleQRCodesSync = nativeDetectMultipleQRCodes;
 const hasQRCodeSync = nativeHasQRCode;
 
+/**
+ * Configures the native worker pool used by the promise-returning functions.
+ * @param {Object} options
+ *   - threads {number} - Number of worker threads (default: CPU count)
+ *   - maxQueue {number} - Maximum number of jobs waiting for a thread (default: 1024)
+ *   - policy {'reject'|'wait'} - When the queue is full, reject with OVERLOADED_ERROR_CODE
+ *     or keep the job pending until a slot frees up (default: 'reject'); the event loop is never blocked
+ *   - maxWaiting {number} - Maximum number of jobs pending with the 'wait' policy; beyond it
+ *     calls reject with OVERLOADED_ERROR_CODE (default: 4096)
+ *   - waitTimeoutMs {number} - Maximum time a job stays pending with the 'wait' policy before
+ *     rejecting with OVERLOADED_ERROR_CODE, 0 = no limit
+ */
+function configurePool(options) {
+  nativeConfigurePool(options);
+}
+
+/**
+ * Returns a snapshot of the native worker pool.
+ * @returns {Object} { threads, maxQueue, maxWaiting, queued, waiting, active, completed, rejected }
+ */
+function getPoolStats() {
+  return nativeGetPoolStats();
+}
+
+/**
+ * Writes the per-method cascade counters to a JSON file so a later process can
+ * start with a warmed-up adaptive order.
+ * @param {string} path - Destination file
+ */
+function saveCascadeStats(path) {
+  fs.writeFileSync(path, JSON.stringify(getCascadeStats(), null, 2));
+}
+
+/**
+ * Replaces the per-method cascade counters with ones saved by saveCascadeStats().
+ * @param {string} path - Source file
+ */
+function loadCascadeStats(path) {
+  setCascadeStats(JSON.parse(fs.readFileSync(path, 'utf8')));
+}
+
+/**
+ * Sets the preprocessing pipeline used by every call that does not pass its own
+ * `pipeline` option. The steps are validated and compiled once, here.
+ * @param {Array<Object>|null} pipeline - Steps tried in order after the unprocessed image,
+ *   or null to restore the built-in cascades. Each step is an op object, e.g.
+ *   { op: 'clahe', clip: 3 }, { op: 'adaptive', block: [11, 31] }, { op: 'gamma', values: [0.7] },
+ *   or { ops: [...] } applying several ops in sequence as one attempt. Steps may also set
+ *   name {string} and onlyBelow {number} (skip unless the shorter image side is smaller).
+ */
+function setPipeline(pipeline) {
+  nativeSetPipeline(pipeline === undefined ? null : pipeline);
+}
+
+/**
+ * Encodes the crop kept by a detection made with cropHandle: true, without
+ * running the detection again. The handle holds only the small padded region.
+ * @param {Object} cropHandle - The cropHandle of a detection result
+ * @param {Object} [options]
+ *   - format {'png'|'jpeg'|'webp'|'raw'} - Output format (default: 'png')
+ *   - quality {number} - JPEG / WebP quality, 0-100 (default: 90)
+ *   - compression {number} - PNG compression level, 0-9 (default: 9)
+ *   - buffer {boolean} - Return the encoded image as a Buffer instead of a data URL
+ * @returns {string|Buffer|Object} Data URL or Buffer, or { width, height, channels, data } for 'raw'
+ */
+function encodeQRCodeImage(cropHandle, options) {
+  return nativeEncodeQRCodeImage(cropHandle, options);
+}
+
+/**
+ * Returns process-wide counters and latency histograms for every entry point,
+ * along with the cascade method counters and worker pool gauges.
+ * @param {string} [format] - 'json' (default) for an object, 'prometheus' for
+ *   text in the Prometheus exposition format
+ * @returns {Object|string} Metrics snapshot
+ */
+function getMetrics(format = 'json') {
+  const metrics = nativeGetMetrics(format);
+  return format === 'json' ? JSON.parse(metrics) : metrics;
+}
+
 module.exports = {
   detectQRCode,
   detectMultipleQRCodes,
@@ -58,5 +216,16 @@ module.exports = {
   detectQRCodeSync,
   detectMultipleQRCodesSync,
   hasQRCodeSync,
+  configurePool,
+  getPoolStats,
+  getCascadeStats,
+  setCascadeStats,
+  resetCascadeStats,
+  saveCascadeStats,
+  loadCascadeStats,
+  setPipeline,
+  encodeQRCodeImage,
+  getMetrics,
+  OVERLOADED_ERROR_CODE,
 };
 
@@ -0,0 +1,192 @@
+#include "base64.h"
+
+// x86 kernels are compiled for their instruction set with target attributes and
+// picked at runtime, so a default build still uses them on CPUs that have them.
+// Compilers without target attributes (MSVC) fall back to the scalar encoder.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define QR_BASE64_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define QR_BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "0123456789+/";
+
+// Helper function to encode whole 3-byte groups and the padded tail one group at a time
+static void EncodeScalar(const uint8_t* data, size_t size, char* out) {
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        uint32_t group = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+        out[0] = kAlphabet[group >> 18];
+        out[1] = kAlphabet[(group >> 12) & 0x3f];
+        out[2] = kAlphabet[(group >> 6) & 0x3f];
+        out[3] = kAlphabet[group & 0x3f];
+        out += 4;
+    }
+
+    if (i < size) {
+        bool two = i + 1 < size;
+        uint32_t group = (uint32_t(data[i]) << 16) | (two ? uint32_t(data[i + 1]) << 8 : 0);
+        out[0] = kAlphabet[group >> 18];
+        out[1] = kAlphabet[(group >> 12) & 0x3f];
+        out[2] = two ? kAlphabet[(group >> 6) & 0x3f] : '=';
+        out[3] = '=';
+    }
+}
+
+// A kernel encodes as many whole groups as it can vectorize and returns the
+// number of input bytes it consumed, always a multiple of 3
+typedef size_t (*Base64Kernel)(const uint8_t* data, size_t size, char* out);
+
+#if defined(QR_BASE64_X86)
+// Spreads each 3-byte group over a 32-bit lane as four 6-bit indices, one per
+// byte: the shuffle puts the group's bytes at b a c b, then the multiplies move
+// the four bit fields to the bottom of their bytes.
+__attribute__((target("ssse3")))
+static inline __m128i SplitSSSE3(__m128i input) {
+    __m128i in = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(high, low);
+}
+
+// Maps indices to characters by adding a per-range offset: the saturating
+// subtract and compare give each of the five ranges its own slot in the
+// offset table, looked up with one shuffle
+__attribute__((target("ssse3")))
+static inline __m128i LookupSSSE3(__m128i indices) {
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i slot = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    slot = _mm_or_si128(slot, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, slot), indices);
+}
+
+__attribute__((target("ssse3")))
+static size_t EncodeSSSE3(const uint8_t* data, size_t size, char* out) {
+    // 12 bytes become 16 characters; each load reads 16, so stop 4 bytes early
+    size_t i = 0;
+    for (; i + 16 <= size; i += 12) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), LookupSSSE3(SplitSSSE3(in)));
+        out += 16;
+    }
+    return i;
+}
+
+// The AVX2 kernel is the SSSE3 one on two 128-bit lanes
+__attribute__((target("avx2")))
+static inline __m256i SplitAVX2(__m256i input) {
+    const __m256i order = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i in = _mm256_shuffle_epi8(input, order);
+    __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+                                      _mm256_set1_epi32(0x04000040));
+    __m256i low = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+                                     _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(high, low);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i LookupAVX2(__m256i indices) {
+    const __m256i offsets = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '+' - 62, '/' - 63, 'A', 0, 0));
+    __m256i slot = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    slot = _mm256_or_si256(slot, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, slot), indices);
+}
+
+__attribute__((target("avx2")))
+static size_t EncodeAVX2(const uint8_t* data, size_t size, char* out) {
+    // 24 bytes become 32 characters, 12 per lane; the upper lane's load reads
+    // bytes 12 to 27, so stop 4 bytes early
+    size_t i = 0;
+    for (; i + 28 <= size; i += 24) {
+        __m128i lower = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i upper = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lower), upper, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), LookupAVX2(SplitAVX2(in)));
+        out += 32;
+    }
+    return i + EncodeSSSE3(data + i, size - i, out);
+}
+#endif
+
+#if defined(QR_BASE64_NEON)
+static size_t EncodeNEON(const uint8_t* data, size_t size, char* out) {
+    const uint8_t* alphabet = reinterpret_cast<const uint8_t*>(kAlphabet);
+    const uint8x16x4_t table = {{
+        vld1q_u8(alphabet), vld1q_u8(alphabet + 16), vld1q_u8(alphabet + 32), vld1q_u8(alphabet + 48)
+    }};
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+
+    // 48 bytes, deinterleaved into first, second and third bytes of 16 groups,
+    // become 64 characters written back interleaved
+    size_t i = 0;
+    for (; i + 48 <= size; i += 48) {
+        uint8x16x3_t in = vld3q_u8(data + i);
+        uint8x16x4_t indices;
+        indices.val[0] = vshrq_n_u8(in.val[0], 2);
+        indices.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        indices.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        indices.val[3] = vandq_u8(in.val[2], mask);
+
+        uint8x16x4_t chars;
+        for (int k = 0; k < 4; k++) {
+            chars.val[k] = vqtbl4q_u8(table, indices.val[k]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+        out += 64;
+    }
+    return i;
+}
+#endif
+
+// Kernel chosen for this CPU, null for the scalar encoder alone
+struct Base64Dispatch {
+    Base64Kernel kernel = nullptr;
+    const char* name = "scalar";
+
+    static const Base64Dispatch& Instance() {
+        static const Base64Dispatch dispatch = Select();
+        return dispatch;
+    }
+
+private:
+    static Base64Dispatch Select() {
+        Base64Dispatch dispatch;
+#if defined(QR_BASE64_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            dispatch.kernel = EncodeAVX2;
+            dispatch.name = "avx2";
+        } else if (__builtin_cpu_supports("ssse3")) {
+            dispatch.kernel = EncodeSSSE3;
+            dispatch.name = "ssse3";
+        }
+#elif defined(QR_BASE64_NEON)
+        dispatch.kernel = EncodeNEON;
+        dispatch.name = "neon";
+#endif
+        return dispatch;
+    }
+};
+
+void EncodeBase64(const uint8_t* data, size_t size, char* out) {
+    const Base64Dispatch& dispatch = Base64Dispatch::Instance();
+    size_t done = dispatch.kernel ? dispatch.kernel(data, size, out) : 0;
+    EncodeScalar(data + done, size - done, out + done / 3 * 4);
+}
+
+const char* Base64Implementation() {
+    return Base64Dispatch::Instance().name;
+}
@@ -0,0 +1,20 @@
+#ifndef QR_BASE64_H
+#define QR_BASE64_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Length of the padded base64 encoding of size bytes
+inline size_t Base64Length(size_t size) {
+    return (size + 2) / 3 * 4;
+}
+
+// Encodes size bytes as padded base64 into out, which must have room for
+// Base64Length(size) characters; no terminator is written. Uses AVX2, SSSE3
+// or NEON when the CPU has them, chosen once per process.
+void EncodeBase64(const uint8_t* data, size_t size, char* out);
+
+// Name of the implementation EncodeBase64 uses: "avx2", "ssse3", "neon" or "scalar"
+const char* Base64Implementation();
+
+#endif // QR_BASE64_H
@@ -0,0 +1,102 @@
+#include "cascade_stats.h"
+
+#include <algorithm>
+
+// Most methods tracked per cascade. Per-call gammas and pipeline step names
+// make method names open-ended; methods beyond this keep their default order.
+static const size_t kMaxMethodsPerCascade = 256;
+
+CascadeStats& CascadeStats::Instance() {
+    static CascadeStats* stats = new CascadeStats();
+    return *stats;
+}
+
+void CascadeStats::Record(const std::string& cascade, const std::string& method, bool hit, double ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, MethodStats>& methods = cascades_[cascade];
+    if (methods.size() >= kMaxMethodsPerCascade && methods.find(method) == methods.end()) {
+        return;
+    }
+    MethodStats& stats = methods[method];
+    stats.method = method;
+    stats.attempts++;
+    if (hit) {
+        stats.hits++;
+    }
+    stats.totalMs += ms;
+}
+
+std::vector<size_t> CascadeStats::Order(const std::string& cascade,
+                                        const std::vector<std::string>& methods) const {
+    std::vector<double> hitRate(methods.size());
+    std::vector<double> cost(methods.size(), 0.0);
+    double knownCost = 0;
+    size_t knownCount = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = cascades_.find(cascade);
+        for (size_t i = 0; i < methods.size(); i++) {
+            uint64_t attempts = 0;
+            uint64_t hits = 0;
+            if (found != cascades_.end()) {
+                auto method = found->second.find(methods[i]);
+                if (method != found->second.end()) {
+                    attempts = method->second.attempts;
+                    hits = method->second.hits;
+                    if (attempts > 0) {
+                        cost[i] = method->second.totalMs / attempts;
+                        knownCost += cost[i];
+                        knownCount++;
+                    }
+                }
+            }
+            // Laplace smoothing so unseen methods still get explored
+            hitRate[i] = (hits + 1.0) / (attempts + 2.0);
+        }
+    }
+
+    // Methods without timings are assumed to cost the average of the others
+    double defaultCost = knownCount > 0 ? knownCost / knownCount : 1.0;
+    std::vector<double> score(methods.size());
+    for (size_t i = 0; i < methods.size(); i++) {
+        double ms = cost[i] > 0 ? cost[i] : defaultCost;
+        score[i] = hitRate[i] / std::max(ms, 1e-3);
+    }
+
+    std::vector<size_t> order(methods.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&score](size_t a, size_t b) {
+        return score[a] > score[b];
+    });
+    return order;
+}
+
+std::map<std::string, std::vector<MethodStats>> CascadeStats::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, std::vector<MethodStats>> snapshot;
+    for (const auto& cascade : cascades_) {
+        std::vector<MethodStats>& methods = snapshot[cascade.first];
+        for (const auto& method : cascade.second) {
+            methods.push_back(method.second);
+        }
+    }
+    return snapshot;
+}
+
+void CascadeStats::Restore(const std::map<std::string, std::vector<MethodStats>>& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cascades_.clear();
+    for (const auto& cascade : snapshot) {
+        for (const MethodStats& method : cascade.second) {
+            cascades_[cascade.first][method.method] = method;
+        }
+    }
+}
+
+void CascadeStats::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cascades_.clear();
+}
@@ -0,0 +1,43 @@
+#ifndef QR_CASCADE_STATS_H
+#define QR_CASCADE_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Observed outcome of one preprocessing method
+struct MethodStats {
+    std::string method;
+    uint64_t attempts = 0;
+    uint64_t hits = 0;
+    double totalMs = 0;
+};
+
+// Process-wide success counters for each cascade ("single", "multiple", the
+// "-roi" region decodes and the "pyramid" and "locate" passes), used
+// to try the methods that usually decode, and are cheap, first.
+class CascadeStats {
+public:
+    static CascadeStats& Instance();
+
+    void Record(const std::string& cascade, const std::string& method, bool hit, double ms);
+
+    // Indices of methods sorted by estimated hit rate per millisecond, best
+    // first. Methods without history keep their relative default order.
+    std::vector<size_t> Order(const std::string& cascade, const std::vector<std::string>& methods) const;
+
+    std::map<std::string, std::vector<MethodStats>> Snapshot() const;
+    void Restore(const std::map<std::string, std::vector<MethodStats>>& snapshot);
+    void Reset();
+
+private:
+    CascadeStats() = default;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::map<std::string, MethodStats>> cascades_;
+};
+
+#endif // QR_CASCADE_STATS_H
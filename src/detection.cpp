@@ -0,0 +1,1704 @@
+#include "detection.h"
+#include "base64.h"
+#include "cascade_stats.h"
+#include "metrics.h"
+#include "preprocess.h"
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Helper function to view a raw frame as a grayscale image. Gray frames and YUV
+// luma planes are wrapped in place; packed color formats are converted.
+static cv::Mat WrapPixels(const ImageSource& source) {
+    uint8_t* data = const_cast<uint8_t*>(source.data);
+    cv::Mat gray;
+    switch (source.format) {
+        case PixelFormat::RGB:
+            cv::cvtColor(cv::Mat(source.height, source.width, CV_8UC3, data, source.stride), gray, cv::COLOR_RGB2GRAY);
+            return gray;
+        case PixelFormat::RGBA:
+            cv::cvtColor(cv::Mat(source.height, source.width, CV_8UC4, data, source.stride), gray, cv::COLOR_RGBA2GRAY);
+            return gray;
+        case PixelFormat::BGR:
+            cv::cvtColor(cv::Mat(source.height, source.width, CV_8UC3, data, source.stride), gray, cv::COLOR_BGR2GRAY);
+            return gray;
+        default:
+            return cv::Mat(source.height, source.width, CV_8UC1, data, source.stride);
+    }
+}
+
+// Helper function to decode a file path or encoded bytes with the given imread flags
+static cv::Mat DecodeEncoded(const ImageSource& source, int flags) {
+    if (source.isPath) {
+        return cv::imread(source.path, flags);
+    }
+    if (source.size == 0 || source.size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return cv::Mat();
+    }
+    // Non-owning header over the caller's bytes, so nothing is copied before decoding
+    cv::Mat bytes(1, static_cast<int>(source.size), CV_8UC1, const_cast<uint8_t*>(source.data));
+    return cv::imdecode(bytes, flags);
+}
+
+// Helper function to pick the imread flags for the decode mode
+static int DecodeFlags(bool gray, int reduction) {
+    switch (reduction) {
+        case 2:
+            return gray ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return gray ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return gray ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return gray ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+    }
+}
+
+DecodedImage LoadImage(const ImageSource& source, const DetectOptions& options, DetectionStats* stats) {
+    std::chrono::steady_clock::time_point start;
+    if (stats) {
+        start = std::chrono::steady_clock::now();
+    }
+
+    DecodedImage image;
+    image.source = &source;
+    image.reduction = options.reduction;
+    if (source.isRaw) {
+        image.pixels = WrapPixels(source);
+        if (options.reduction > 1 && !image.pixels.empty()) {
+            cv::resize(image.pixels, image.pixels, cv::Size(), 1.0 / options.reduction, 1.0 / options.reduction,
+                       cv::INTER_AREA);
+        }
+    } else {
+        image.pixels = DecodeEncoded(source, DecodeFlags(options.grayDecode, options.reduction));
+    }
+
+    if (stats) {
+        stats->decodeMs = ElapsedMs(start);
+    }
+    return image;
+}
+
+cv::Mat CropQRCodeRegion(const cv::Mat& image, const std::vector<cv::Point>& corners) {
+    if (corners.size() < 4) {
+        return cv::Mat();
+    }
+
+    // Get bounding rectangle
+    cv::Rect boundingRect = cv::boundingRect(corners);
+
+    // Add padding
+    int padding = 10;
+    boundingRect.x = std::max(0, boundingRect.x - padding);
+    boundingRect.y = std::max(0, boundingRect.y - padding);
+    boundingRect.width = std::min(image.cols - boundingRect.x, boundingRect.width + 2 * padding);
+    boundingRect.height = std::min(image.rows - boundingRect.y, boundingRect.height + 2 * padding);
+
+    boundingRect &= cv::Rect(0, 0, image.cols, image.rows);
+    if (boundingRect.empty()) {
+        return cv::Mat();
+    }
+
+    // Extract QR code region
+    return image(boundingRect);
+}
+
+// Helper function to map a crop format to its imencode extension and MIME type
+static bool CropFormatInfo(CropFormat format, const char*& extension, const char*& mimeType) {
+    switch (format) {
+        case CropFormat::PNG:
+            extension = ".png";
+            mimeType = "image/png";
+            return true;
+        case CropFormat::JPEG:
+            extension = ".jpg";
+            mimeType = "image/jpeg";
+            return true;
+        case CropFormat::WebP:
+            extension = ".webp";
+            mimeType = "image/webp";
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool EncodeQRCodeBytes(const cv::Mat& region, const CropEncoding& encoding, std::vector<uint8_t>& buffer,
+                       DetectionStats* stats) {
+    const char* extension;
+    const char* mimeType;
+    if (region.empty() || !CropFormatInfo(encoding.format, extension, mimeType)) {
+        return false;
+    }
+
+    std::vector<int> params;
+    if (encoding.format == CropFormat::PNG) {
+        params = {cv::IMWRITE_PNG_COMPRESSION, encoding.compression};
+    } else if (encoding.format == CropFormat::JPEG) {
+        params = {cv::IMWRITE_JPEG_QUALITY, encoding.quality};
+    } else {
+        params = {cv::IMWRITE_WEBP_QUALITY, std::max(1, encoding.quality)};
+    }
+
+    std::chrono::steady_clock::time_point start;
+    if (stats) {
+        start = std::chrono::steady_clock::now();
+    }
+    bool encoded = cv::imencode(extension, region, buffer, params);
+    if (stats) {
+        stats->encodeMs += ElapsedMs(start);
+    }
+    return encoded;
+}
+
+std::string EncodeQRCodeImage(const cv::Mat& region, const CropEncoding& encoding,
+                              DetectionStats* stats) {
+    std::vector<uint8_t> buffer;
+    const char* extension;
+    const char* mimeType;
+    if (!CropFormatInfo(encoding.format, extension, mimeType) ||
+        !EncodeQRCodeBytes(region, encoding, buffer, stats)) {
+        return std::string();
+    }
+
+    std::chrono::steady_clock::time_point start;
+    if (stats) {
+        start = std::chrono::steady_clock::now();
+    }
+    // Encoded straight into the string, sized up front
+    std::string dataUrl = std::string("data:") + mimeType + ";base64,";
+    size_t prefixLength = dataUrl.size();
+    dataUrl.resize(prefixLength + Base64Length(buffer.size()));
+    EncodeBase64(buffer.data(), buffer.size(), &dataUrl[prefixLength]);
+    if (stats) {
+        stats->base64Ms += ElapsedMs(start);
+    }
+    return dataUrl;
+}
+
+// Helper function to convert the input image to grayscale for the cascade
+static cv::Mat ToGray(const cv::Mat& image) {
+    if (image.channels() == 1) {
+        // The cascade only reads the grayscale image, so share the pixels
+        return image;
+    }
+    cv::Mat gray;
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+// Helper function to get this thread's QR code detector. Construction allocates
+// the detector's internals, so each pool and OpenCV thread keeps one instance;
+// it holds no per-image state between calls and its settings are never changed.
+static cv::QRCodeDetector& ThreadDetector() {
+    thread_local cv::QRCodeDetector detector;
+    return detector;
+}
+
+// Helper function to get this thread's CLAHE object, reset to the given clip
+// limit and an 8x8 grid. The object keeps its scratch buffers between calls.
+static cv::Ptr<cv::CLAHE>& ThreadClahe(double clipLimit) {
+    thread_local cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(clipLimit, cv::Size(8, 8));
+    clahe->setClipLimit(clipLimit);
+    clahe->setTilesGridSize(cv::Size(8, 8));
+    return clahe;
+}
+
+// Helper function to build the gamma correction lookup table
+static cv::Mat BuildGammaTable(double gamma) {
+    cv::Mat lookUpTable(1, 256, CV_8U);
+    uchar* p = lookUpTable.ptr();
+    for(int i = 0; i < 256; ++i)
+        p[i] = cv::saturate_cast<uchar>(pow(i / 255.0, gamma) * 255.0);
+    return lookUpTable;
+}
+
+// Helper function to get the gamma correction lookup table. The tables of the
+// default gammas are built once and never change, so every call and thread
+// reads them without locking; any other gamma gets a fresh table, which takes
+// 256 pow() calls, far less than applying it to an image.
+static cv::Mat GammaTable(double gamma) {
+    static const std::map<double, cv::Mat> defaults = [] {
+        std::map<double, cv::Mat> tables;
+        for (double value : DetectOptions().gammas) {
+            tables[value] = BuildGammaTable(value);
+        }
+        return tables;
+    }();
+
+    auto found = defaults.find(gamma);
+    return found != defaults.end() ? found->second : BuildGammaTable(gamma);
+}
+
+// Helper function to name the gamma step; the defaults keep their
+// one-decimal names ("gamma-2.0") so saved cascade stats still match
+static std::string GammaMethod(double gamma) {
+    std::string name = cv::format("%.1f", gamma);
+    if (std::stod(name) != gamma) {
+        name = cv::format("%g", gamma);
+    }
+    return "gamma-" + name;
+}
+
+// Constant subtracted from the neighbourhood mean by every adaptive threshold
+static const int kAdaptiveDelta = 2;
+
+// Helper function to binarize against the mean of each pixel's neighbourhood,
+// or against the Gaussian-weighted mean when gaussian is set
+static cv::Mat AdaptiveThreshold(const cv::Mat& gray, int blockSize, bool gaussian) {
+    if (!gaussian) {
+        return MeanAdaptiveThresholds(gray, {blockSize}, kAdaptiveDelta)[0];
+    }
+    cv::Mat binary;
+    cv::adaptiveThreshold(gray, binary, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                        cv::THRESH_BINARY, blockSize, kAdaptiveDelta);
+    return binary;
+}
+
+// Variants of one grayscale image that are cheapest to compute together. When
+// fused, the first attempt that needs one builds the whole group, which pays off
+// when the attempts run concurrently; otherwise each plane is built on its own
+// when it is taken, so a serial cascade that hits early builds nothing else.
+// Each plane is handed out once, so its memory is freed as soon as that
+// attempt is done with it.
+class PlaneGroup {
+public:
+    PlaneGroup(const cv::Mat& gray, bool fused) : gray_(gray), fused_(fused) {}
+    virtual ~PlaneGroup() = default;
+
+    // Plane for the index returned when it was added. Time spent building or
+    // waiting for the fused group is added to sharedMs, since it is not the
+    // cost of this plane alone.
+    cv::Mat Take(size_t index, double& sharedMs) {
+        if (!fused_) {
+            return BuildOne(index);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::call_once(built_, [this]() { planes_ = BuildAll(); });
+        sharedMs += ElapsedMs(start);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv::Mat pixels = planes_[index];
+        planes_[index].release();
+        return pixels;
+    }
+
+protected:
+    // One plane per added variant, in the order they were added
+    virtual std::vector<cv::Mat> BuildAll() = 0;
+
+    // The plane of one added variant
+    virtual cv::Mat BuildOne(size_t index) = 0;
+
+    cv::Mat gray_;
+
+private:
+    bool fused_;
+    std::vector<cv::Mat> planes_;
+    std::once_flag built_;
+    std::mutex mutex_;
+};
+
+// Per-pixel lookups of the grayscale image: histogram equalization, Otsu,
+// inverted Otsu and the gamma steps. Fused, they are built with a single
+// histogram read and a single pass over the image; one at a time, the
+// histogram is still read only once.
+class LookupPlanes : public PlaneGroup {
+public:
+    enum Kind { Equalize, Otsu, OtsuInverted, Gamma };
+
+    LookupPlanes(const cv::Mat& gray, bool fused) : PlaneGroup(gray, fused) {}
+
+    size_t Add(Kind kind, double gamma = 1.0) {
+        specs_.push_back({kind, gamma});
+        return specs_.size() - 1;
+    }
+
+private:
+    struct Spec {
+        Kind kind;
+        double gamma;
+    };
+
+    const GrayHistogram& Histogram() {
+        std::call_once(counted_, [this]() { histogram_ = ComputeHistogram(gray_); });
+        return histogram_;
+    }
+
+    cv::Mat Table(const Spec& spec) {
+        switch (spec.kind) {
+            case Equalize: return EqualizeTable(Histogram());
+            case Otsu: return ThresholdTable(OtsuThreshold(Histogram()), false);
+            case OtsuInverted: return ThresholdTable(OtsuThreshold(Histogram()), true);
+            case Gamma: break;
+        }
+        return GammaTable(spec.gamma);
+    }
+
+    std::vector<cv::Mat> BuildAll() override {
+        std::vector<cv::Mat> tables;
+        for (const Spec& spec : specs_) {
+            tables.push_back(Table(spec));
+        }
+        return ApplyTables(gray_, tables);
+    }
+
+    cv::Mat BuildOne(size_t index) override {
+        return ApplyTables(gray_, {Table(specs_[index])})[0];
+    }
+
+    std::vector<Spec> specs_;
+    GrayHistogram histogram_{};
+    std::once_flag counted_;
+};
+
+// Mean adaptive thresholds of the grayscale image for several block sizes;
+// fused, all of them are thresholded in one pass over the image
+class AdaptivePlanes : public PlaneGroup {
+public:
+    AdaptivePlanes(const cv::Mat& gray, bool fused) : PlaneGroup(gray, fused) {}
+
+    size_t Add(int blockSize) {
+        blockSizes_.push_back(blockSize);
+        return blockSizes_.size() - 1;
+    }
+
+private:
+    std::vector<cv::Mat> BuildAll() override {
+        return MeanAdaptiveThresholds(gray_, blockSizes_, kAdaptiveDelta);
+    }
+
+    cv::Mat BuildOne(size_t index) override {
+        return MeanAdaptiveThresholds(gray_, {blockSizes_[index]}, kAdaptiveDelta)[0];
+    }
+
+    std::vector<int> blockSizes_;
+};
+
+// One step of the preprocessing cascade. prepare() builds the variant from the
+// grayscale image and adds the time spent on work shared with other attempts
+// (a fused plane group) to sharedMs, so it is kept out of this attempt's
+// timing and its cascade counters; scale is the variant size relative to the original, used to
+// map the corners back. With corners the code was already located, and the
+// variant is only decoded there instead of searched.
+struct CascadeAttempt {
+    std::string method;
+    std::function<cv::Mat(const cv::Mat& gray, double& sharedMs)> prepare;
+    double scale = 1.0;
+    std::vector<cv::Point2f> corners;
+};
+
+// Builds the list of attempts for a cascade from the grayscale image
+typedef std::vector<CascadeAttempt> (*CascadeBuilder)(const cv::Mat& gray, const DetectOptions& options);
+
+// Helper function to describe an op for the default step names
+static PipelineOp MakeOp(PipelineOp::Kind kind, double value = 0, bool inverted = false) {
+    PipelineOp op;
+    op.kind = kind;
+    op.value = value;
+    op.inverted = inverted;
+    return op;
+}
+
+// Fallback chain used by DetectQRCodeInImage, in the order it is tried
+static Pipeline DefaultSinglePipeline(const DetectOptions& options) {
+    Pipeline pipeline;
+
+    // Method 1: Contrast enhancement with CLAHE
+    pipeline.push_back({"", {MakeOp(PipelineOp::Clahe, 3.0)}});
+
+    // Method 2: Adaptive thresholding (multiple block sizes)
+    for (int blockSize : {11, 15, 21, 31, 51}) {
+        pipeline.push_back({"", {MakeOp(PipelineOp::Adaptive, blockSize)}});
+    }
+
+    // Method 3: Otsu's thresholding
+    pipeline.push_back({"", {MakeOp(PipelineOp::Otsu)}});
+
+    // Method 4: Inverted Otsu (for dark QR on light background)
+    pipeline.push_back({"", {MakeOp(PipelineOp::Otsu, 0, true)}});
+
+    // Method 5: Bilateral filter + adaptive threshold (noise reduction)
+    pipeline.push_back({"bilateral-adaptive", {MakeOp(PipelineOp::Bilateral, 9),
+                                               MakeOp(PipelineOp::Adaptive, 11)}});
+
+    // Method 6: Morphological operations
+    pipeline.push_back({"morph-close", {MakeOp(PipelineOp::Otsu), MakeOp(PipelineOp::MorphClose, 3)}});
+
+    // Method 7: Sharpen the image
+    pipeline.push_back({"", {MakeOp(PipelineOp::Sharpen)}});
+
+    // Method 8: Resize larger (for small QR codes)
+    pipeline.push_back({"", {MakeOp(PipelineOp::Resize, 2.0)}, 800});
+
+    // Method 9: Gamma correction for low light images
+    for (double gamma : options.gammas) {
+        pipeline.push_back({"", {MakeOp(PipelineOp::Gamma, gamma)}});
+    }
+
+    // Method 10: Histogram equalization
+    pipeline.push_back({"", {MakeOp(PipelineOp::Equalize)}});
+
+    // Method 11: Combination - CLAHE + Bilateral + Adaptive Threshold
+    pipeline.push_back({"clahe-bilateral-adaptive", {MakeOp(PipelineOp::Clahe, 4.0),
+                                                     MakeOp(PipelineOp::Bilateral, 9),
+                                                     MakeOp(PipelineOp::Adaptive, 21)}});
+
+    // Method 12: Try on resized + enhanced version
+    pipeline.push_back({"", {MakeOp(PipelineOp::Resize, 1.5), MakeOp(PipelineOp::Clahe, 3.0)}});
+
+    return pipeline;
+}
+
+// Shorter fallback chain used by DetectMultipleQRCodesInImage
+static Pipeline DefaultMultiplePipeline(const DetectOptions& options) {
+    Pipeline pipeline;
+
+    // Method 1: CLAHE
+    pipeline.push_back({"", {MakeOp(PipelineOp::Clahe, 3.0)}});
+
+    // Method 2: Adaptive thresholding
+    for (int blockSize : {11, 15, 21, 31, 51}) {
+        pipeline.push_back({"", {MakeOp(PipelineOp::Adaptive, blockSize)}});
+    }
+
+    // Method 3: Gamma correction
+    for (double gamma : options.gammas) {
+        pipeline.push_back({"", {MakeOp(PipelineOp::Gamma, gamma)}});
+    }
+
+    // Method 4: Resize + enhance
+    pipeline.push_back({"", {MakeOp(PipelineOp::Resize, 1.5), MakeOp(PipelineOp::Clahe, 3.0)}});
+
+    return pipeline;
+}
+
+// Helper function to name a step after its ops, e.g. "resize-1.5x-clahe"
+static std::string StepMethod(const PipelineStep& step) {
+    std::string method;
+    for (const PipelineOp& op : step.ops) {
+        std::string name;
+        switch (op.kind) {
+            case PipelineOp::Clahe:
+                name = op.value == 3.0 ? "clahe" : cv::format("clahe-%g", op.value);
+                break;
+            case PipelineOp::Adaptive: name = cv::format("adaptive-%d", static_cast<int>(op.value)); break;
+            case PipelineOp::Otsu: name = op.inverted ? "otsu-inverted" : "otsu"; break;
+            case PipelineOp::Bilateral: name = "bilateral"; break;
+            case PipelineOp::MorphClose: name = "morph-close"; break;
+            case PipelineOp::Sharpen: name = "sharpen"; break;
+            case PipelineOp::Resize: name = cv::format("resize-%gx", op.value); break;
+            case PipelineOp::Gamma: name = GammaMethod(op.value); break;
+            case PipelineOp::Equalize: name = "equalize-hist"; break;
+        }
+        method += (method.empty() ? "" : "-") + name;
+    }
+    return method;
+}
+
+// Helper function to apply one op of a step to the previous op's output
+static cv::Mat ApplyOp(const PipelineOp& op, const cv::Mat& input, bool gaussian) {
+    cv::Mat output;
+    switch (op.kind) {
+        case PipelineOp::Clahe:
+            ThreadClahe(op.value)->apply(input, output);
+            break;
+        case PipelineOp::Adaptive:
+            output = AdaptiveThreshold(input, static_cast<int>(op.value), gaussian);
+            break;
+        case PipelineOp::Otsu:
+            cv::threshold(input, output, 0, 255,
+                          (op.inverted ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY) | cv::THRESH_OTSU);
+            break;
+        case PipelineOp::Bilateral:
+            cv::bilateralFilter(input, output, static_cast<int>(op.value), op.sigma, op.sigma);
+            break;
+        case PipelineOp::MorphClose: {
+            int size = static_cast<int>(op.value);
+            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(size, size));
+            cv::morphologyEx(input, output, cv::MORPH_CLOSE, kernel);
+            break;
+        }
+        case PipelineOp::Sharpen: {
+            static const cv::Mat kernel = (cv::Mat_<float>(3,3) <<
+                0, -1, 0,
+                -1, 5, -1,
+                0, -1, 0);
+            cv::filter2D(input, output, -1, kernel);
+            break;
+        }
+        case PipelineOp::Resize:
+            cv::resize(input, output, cv::Size(), op.value, op.value, cv::INTER_CUBIC);
+            break;
+        case PipelineOp::Gamma:
+            cv::LUT(input, GammaTable(op.value), output);
+            break;
+        case PipelineOp::Equalize:
+            cv::equalizeHist(input, output);
+            break;
+    }
+    return output;
+}
+
+// The variants of one call as a DAG. Every distinct prefix of ops across the
+// pipeline's steps is a node, so steps that start with the same ops (Otsu and
+// Otsu + close, or two chains behind one bilateral filter) share that
+// intermediate image. A node is computed the first time a step needs it and
+// freed once every step and child node reading it has taken it. Single lookup
+// and mean adaptive threshold nodes on the grayscale image come from the fused
+// plane groups, which are fused only for a parallel cascade.
+class VariantGraph {
+public:
+    VariantGraph(const cv::Mat& gray, bool gaussian, bool fused)
+        : gray_(gray), gaussian_(gaussian),
+          lookups_(std::make_shared<LookupPlanes>(gray, fused)),
+          adaptive_(std::make_shared<AdaptivePlanes>(gray, fused)) {}
+
+    // Adds the nodes for a step's ops and returns the node holding its variant
+    size_t AddStep(const std::vector<PipelineOp>& ops) {
+        CV_Assert(!ops.empty());
+        int parent = -1;
+        for (const PipelineOp& op : ops) {
+            parent = static_cast<int>(AddNode(parent, op));
+        }
+        nodes_[parent]->consumers++;
+        return static_cast<size_t>(parent);
+    }
+
+    // Variant of a node; each step's node is taken once. Time spent on a fused
+    // plane group is added to sharedMs.
+    cv::Mat Take(size_t id, double& sharedMs) {
+        Node& node = *nodes_[id];
+        std::call_once(node.computed, [this, &node, &sharedMs]() { node.pixels = Compute(node, sharedMs); });
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv::Mat pixels = node.pixels;
+        if (--node.consumers <= 0) {
+            node.pixels.release();
+        }
+        return pixels;
+    }
+
+private:
+    struct Node {
+        int parent;                     // -1 = the grayscale image
+        PipelineOp op;
+        std::shared_ptr<PlaneGroup> group;
+        size_t groupIndex = 0;
+        int consumers = 0;              // child nodes and steps still to read it
+        std::once_flag computed;
+        cv::Mat pixels;
+    };
+
+    size_t AddNode(int parent, const PipelineOp& op) {
+        std::string key = cv::format("%d/%d:%g:%g:%d", parent, static_cast<int>(op.kind), op.value,
+                                     op.sigma, op.inverted ? 1 : 0);
+        auto found = index_.find(key);
+        if (found != index_.end()) {
+            return found->second;
+        }
+
+        std::unique_ptr<Node> node(new Node());
+        node->parent = parent;
+        node->op = op;
+        if (parent < 0) {
+            if (op.kind == PipelineOp::Otsu) {
+                node->group = lookups_;
+                node->groupIndex = lookups_->Add(op.inverted ? LookupPlanes::OtsuInverted : LookupPlanes::Otsu);
+            } else if (op.kind == PipelineOp::Equalize) {
+                node->group = lookups_;
+                node->groupIndex = lookups_->Add(LookupPlanes::Equalize);
+            } else if (op.kind == PipelineOp::Gamma) {
+                node->group = lookups_;
+                node->groupIndex = lookups_->Add(LookupPlanes::Gamma, op.value);
+            } else if (op.kind == PipelineOp::Adaptive && !gaussian_) {
+                node->group = adaptive_;
+                node->groupIndex = adaptive_->Add(static_cast<int>(op.value));
+            }
+        } else {
+            nodes_[parent]->consumers++;
+        }
+
+        nodes_.push_back(std::move(node));
+        index_[key] = nodes_.size() - 1;
+        return nodes_.size() - 1;
+    }
+
+    cv::Mat Compute(const Node& node, double& sharedMs) {
+        if (node.group) {
+            return node.group->Take(node.groupIndex, sharedMs);
+        }
+        cv::Mat input = node.parent < 0 ? gray_ : Take(static_cast<size_t>(node.parent), sharedMs);
+        return ApplyOp(node.op, input, gaussian_);
+    }
+
+    cv::Mat gray_;
+    bool gaussian_;
+    std::shared_ptr<LookupPlanes> lookups_;
+    std::shared_ptr<AdaptivePlanes> adaptive_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::map<std::string, size_t> index_;
+    std::mutex mutex_;
+};
+
+// Turn a pipeline into the attempts for this image, all drawing their
+// variants from one VariantGraph
+static std::vector<CascadeAttempt> CompilePipeline(const Pipeline& pipeline, const cv::Mat& gray,
+                                                   const DetectOptions& options) {
+    std::vector<CascadeAttempt> attempts;
+    auto graph = std::make_shared<VariantGraph>(gray, options.gaussianThreshold, options.parallel);
+    const int shorterSide = std::min(gray.cols, gray.rows);
+
+    for (const PipelineStep& step : pipeline) {
+        if (step.onlyBelow > 0 && shorterSide >= step.onlyBelow) {
+            continue;
+        }
+
+        double scale = 1.0;
+        for (const PipelineOp& op : step.ops) {
+            if (op.kind == PipelineOp::Resize) {
+                scale *= op.value;
+            }
+        }
+        size_t node = graph->AddStep(step.ops);
+        CascadeAttempt attempt;
+        attempt.method = step.method.empty() ? StepMethod(step) : step.method;
+        attempt.prepare = [graph, node](const cv::Mat&, double& sharedMs) { return graph->Take(node, sharedMs); };
+        attempt.scale = scale;
+        attempts.push_back(std::move(attempt));
+    }
+    return attempts;
+}
+
+// Cascade used by DetectQRCodeInImage: the caller's pipeline or the built-in one
+static std::vector<CascadeAttempt> BuildSingleCascade(const cv::Mat& gray, const DetectOptions& options) {
+    if (options.pipeline) {
+        return CompilePipeline(*options.pipeline, gray, options);
+    }
+    return CompilePipeline(DefaultSinglePipeline(options), gray, options);
+}
+
+// Cascade used by DetectMultipleQRCodesInImage: the caller's pipeline or the built-in one
+static std::vector<CascadeAttempt> BuildMultipleCascade(const cv::Mat& gray, const DetectOptions& options) {
+    if (options.pipeline) {
+        return CompilePipeline(*options.pipeline, gray, options);
+    }
+    return CompilePipeline(DefaultMultiplePipeline(options), gray, options);
+}
+
+// Outcome of a single cascade attempt
+struct AttemptResult {
+    std::string data;
+    std::vector<cv::Point> points;
+};
+
+// Helper function to round located corners to pixel positions
+static std::vector<cv::Point> RoundCorners(const std::vector<cv::Point2f>& corners) {
+    std::vector<cv::Point> rounded;
+    for (const cv::Point2f& corner : corners) {
+        rounded.push_back(cv::Point(cvRound(corner.x), cvRound(corner.y)));
+    }
+    return rounded;
+}
+
+// Helper function to decode an attempt's variant and map the corners back to original scale
+static AttemptResult DecodeVariant(cv::QRCodeDetector& qrDecoder, const CascadeAttempt& attempt,
+                                   const cv::Mat& variant) {
+    AttemptResult result;
+    if (!attempt.corners.empty()) {
+        std::vector<cv::Point2f> corners;
+        for (const cv::Point2f& corner : attempt.corners) {
+            corners.push_back(corner * attempt.scale);
+        }
+        result.data = qrDecoder.decode(variant, corners);
+        if (!result.data.empty()) {
+            result.points = RoundCorners(attempt.corners);
+        }
+        return result;
+    }
+
+    result.data = qrDecoder.detectAndDecode(variant, result.points);
+    if (!result.data.empty() && attempt.scale != 1.0) {
+        for (auto& point : result.points) {
+            point.x /= attempt.scale;
+            point.y /= attempt.scale;
+        }
+    }
+    return result;
+}
+
+// Longest deadline, about 31 years; longer timeouts are clamped to it so the
+// conversion to microseconds stays in range
+static const double kMaxTimeoutMs = 1e12;
+
+// Per-call limits on the cascade. The deadline is checked between attempts;
+// a detectAndDecode pass that is already running is never interrupted.
+struct CascadeBudget {
+    bool hasDeadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    size_t maxAttempts = 0;     // 0 = unlimited
+
+    explicit CascadeBudget(const DetectOptions& options) {
+        if (options.timeoutMs > 0) {
+            hasDeadline = true;
+            deadline = std::chrono::steady_clock::now() +
+                std::chrono::microseconds(static_cast<int64_t>(std::min(options.timeoutMs, kMaxTimeoutMs) * 1000.0));
+        }
+        maxAttempts = options.maxAttempts;
+    }
+
+    bool Expired() const {
+        return hasDeadline && std::chrono::steady_clock::now() >= deadline;
+    }
+};
+
+// Helper function to count one attempt in the ordering statistics and in the
+// process-wide metrics
+static void RecordAttempt(const std::string& cascade, const std::string& method, bool hit, double ms) {
+    CascadeStats::Instance().Record(cascade, method, hit, ms);
+    Metrics::Instance().RecordMethod(cascade, method, hit);
+}
+
+// Run the cascade until an attempt decodes. Unless a fixed order is requested,
+// attempts are reordered by their observed hit rate per unit cost. In parallel
+// mode every attempt is evaluated concurrently; attempts later in the chain
+// than the best success so far are skipped, and the earliest success wins so
+// the result matches the serial order.
+static bool RunCascade(const std::string& cascade, std::vector<CascadeAttempt> attempts,
+                       const cv::Mat& gray, const DetectOptions& options,
+                       const CascadeBudget& budget, size_t attemptsLeft, std::string& data,
+                       std::vector<cv::Point>& points, DetectionReport& report) {
+    CascadeStats& stats = CascadeStats::Instance();
+
+    if (options.adaptiveOrder) {
+        std::vector<std::string> methods;
+        for (const CascadeAttempt& attempt : attempts) {
+            methods.push_back(attempt.method);
+        }
+        std::vector<CascadeAttempt> ordered;
+        for (size_t index : stats.Order(cascade, methods)) {
+            ordered.push_back(std::move(attempts[index]));
+        }
+        attempts = std::move(ordered);
+    }
+
+    // Only the first attempts in the final order fit in the attempt budget
+    if (budget.maxAttempts > 0 && attempts.size() > attemptsLeft) {
+        attempts.resize(attemptsLeft);
+    }
+
+    const int count = static_cast<int>(attempts.size());
+
+    if (!options.parallel || count < 2) {
+        cv::QRCodeDetector& qrDecoder = ThreadDetector();
+        for (const CascadeAttempt& attempt : attempts) {
+            if (budget.Expired()) {
+                report.timedOut = true;
+                return false;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            double sharedMs = 0;
+            AttemptResult result = DecodeVariant(qrDecoder, attempt, attempt.prepare(gray, sharedMs));
+            bool hit = !result.data.empty();
+            double ms = std::max(0.0, ElapsedMs(start) - sharedMs);
+            report.stats.sharedMs += sharedMs;
+            RecordAttempt(cascade, attempt.method, hit, ms);
+            report.methodsTried.push_back(attempt.method);
+            if (options.stats) {
+                report.stats.methods.push_back({attempt.method, ms, hit});
+                report.stats.detectCalls++;
+            }
+            if (hit) {
+                data = std::move(result.data);
+                points = std::move(result.points);
+                if (options.stats) {
+                    report.stats.method = attempt.method;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<AttemptResult> results(attempts.size());
+    std::vector<char> tried(attempts.size(), 0);
+    std::vector<double> elapsed(attempts.size(), 0.0);
+    std::vector<double> shared(attempts.size(), 0.0);
+    std::atomic<int> best(count);
+    std::atomic<bool> timedOut(false);
+
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        cv::QRCodeDetector& qrDecoder = ThreadDetector();
+        for (int i = range.start; i < range.end; i++) {
+            // Cancelled: an earlier attempt already decoded
+            if (best.load() < i) {
+                continue;
+            }
+            if (budget.Expired()) {
+                timedOut = true;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            cv::Mat variant = attempts[i].prepare(gray, shared[i]);
+            if (best.load() < i) {
+                continue;
+            }
+            if (budget.Expired()) {
+                timedOut = true;
+                continue;
+            }
+
+            results[i] = DecodeVariant(qrDecoder, attempts[i], variant);
+            tried[i] = 1;
+            bool hit = !results[i].data.empty();
+            elapsed[i] = std::max(0.0, ElapsedMs(start) - shared[i]);
+            RecordAttempt(cascade, attempts[i].method, hit, elapsed[i]);
+            if (!hit) {
+                continue;
+            }
+
+            int current = best.load();
+            while (i < current && !best.compare_exchange_weak(current, i)) {
+            }
+        }
+    }, count);
+
+    for (int i = 0; i < count; i++) {
+        report.stats.sharedMs += shared[i];
+        if (tried[i]) {
+            report.methodsTried.push_back(attempts[i].method);
+            if (options.stats) {
+                report.stats.methods.push_back({attempts[i].method, elapsed[i], !results[i].data.empty()});
+                report.stats.detectCalls++;
+            }
+        }
+    }
+
+    int winner = best.load();
+    if (winner == count) {
+        report.timedOut = timedOut.load();
+        return false;
+    }
+    data = std::move(results[winner].data);
+    points = std::move(results[winner].points);
+    if (options.stats) {
+        report.stats.method = attempts[winner].method;
+    }
+    return true;
+}
+
+// Helper function to count the attempts the budget still allows, 0 when spent
+static size_t AttemptsLeft(const CascadeBudget& budget, const DetectionReport& report) {
+    if (budget.maxAttempts == 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+    return budget.maxAttempts > report.methodsTried.size() ? budget.maxAttempts - report.methodsTried.size() : 0;
+}
+
+// Helper function to check the budget before another pass
+static bool CanContinue(const CascadeBudget& budget, DetectionReport& report) {
+    if (AttemptsLeft(budget, report) == 0) {
+        return false;
+    }
+    if (budget.Expired()) {
+        report.timedOut = true;
+        return false;
+    }
+    return true;
+}
+
+// Try the image as-is, then run the preprocessing cascade on a miss. The budget
+// may be shared by several calls; attempts already in the report count against it.
+// With corners, every attempt decodes at them instead of locating the code again.
+static bool DecodeWithCascade(const std::string& cascade,
+                              CascadeBuilder buildCascade,
+                              const cv::Mat& image, const DetectOptions& options,
+                              const CascadeBudget& budget, std::string& data,
+                              std::vector<cv::Point>& points, DetectionReport& report,
+                              const std::vector<cv::Point2f>& corners = std::vector<cv::Point2f>()) {
+    if (AttemptsLeft(budget, report) == 0) {
+        return false;
+    }
+    if (budget.Expired()) {
+        report.timedOut = true;
+        return false;
+    }
+
+    // Reuse this thread's QR code detector
+    cv::QRCodeDetector& qrDecoder = ThreadDetector();
+
+    // Try to detect and decode QR code
+    auto start = std::chrono::steady_clock::now();
+    if (corners.empty()) {
+        data = qrDecoder.detectAndDecode(image, points);
+    } else {
+        data = qrDecoder.decode(image, corners);
+        points = RoundCorners(corners);
+    }
+    double originalMs = ElapsedMs(start);
+    RecordAttempt(cascade, "original", !data.empty(), originalMs);
+    report.methodsTried.push_back("original");
+    if (options.stats) {
+        report.stats.methods.push_back({"original", originalMs, !data.empty()});
+        report.stats.detectCalls++;
+        if (!data.empty()) {
+            report.stats.method = "original";
+        }
+    }
+    if (!data.empty()) {
+        return true;
+    }
+
+    size_t attemptsLeft = AttemptsLeft(budget, report);
+    if (attemptsLeft == 0) {
+        return false;
+    }
+    if (budget.Expired()) {
+        report.timedOut = true;
+        return false;
+    }
+
+    // If not detected, try multiple preprocessing approaches
+    start = std::chrono::steady_clock::now();
+    cv::Mat gray = ToGray(image);
+    report.stats.grayMs += ElapsedMs(start);
+    std::vector<CascadeAttempt> attempts = buildCascade(gray, options);
+    for (CascadeAttempt& attempt : attempts) {
+        attempt.corners = corners;
+    }
+    return RunCascade(cascade, std::move(attempts), gray, options, budget,
+                      attemptsLeft, data, points, report);
+}
+
+// Helper function to grow a region by padding on every side, clipped to the image
+static cv::Rect PadRegion(cv::Rect region, int padding, const cv::Mat& image) {
+    region.x -= padding;
+    region.y -= padding;
+    region.width += 2 * padding;
+    region.height += 2 * padding;
+    return region & cv::Rect(0, 0, image.cols, image.rows);
+}
+
+// Smallest side of a pyramid level worth localizing on
+static const int kMinPyramidSide = 160;
+
+// Helper function to locate a code on a 1/factor copy of the image. Returns the
+// padded full-resolution region around it, or an empty rect if none was found.
+// Corners found on the small copy are returned in full-resolution coordinates.
+// The locate pass counts as an attempt, "pyramid-locate" in the "pyramid"
+// cascade, whether or not the region then decodes.
+static cv::Rect LocalizeOnPyramid(const cv::Mat& image, int factor, const DetectOptions& options,
+                                  std::vector<cv::Point>& corners, DetectionReport& report) {
+    // Too small to gain anything from the pyramid
+    if (std::min(image.cols, image.rows) / factor < kMinPyramidSide) {
+        return cv::Rect();
+    }
+
+    // Shrink first and convert the small copy, so the full-resolution image is
+    // read once instead of also being converted to gray at full size
+    auto start = std::chrono::steady_clock::now();
+    cv::Mat small;
+    cv::resize(image, small, cv::Size(), 1.0 / factor, 1.0 / factor, cv::INTER_AREA);
+    small = ToGray(small);
+
+    cv::QRCodeDetector& qrDetector = ThreadDetector();
+    std::vector<cv::Point2f> found;
+    bool detected = qrDetector.detect(small, found) && found.size() == 4;
+    double ms = ElapsedMs(start);
+    report.methodsTried.push_back("pyramid-locate");
+    RecordAttempt("pyramid", "pyramid-locate", detected, ms);
+    if (options.stats) {
+        report.stats.methods.push_back({"pyramid-locate", ms, detected});
+        report.stats.detectCalls++;
+    }
+    if (!detected) {
+        return cv::Rect();
+    }
+
+    corners.clear();
+    for (const cv::Point2f& point : found) {
+        corners.push_back(cv::Point(cvRound(point.x * factor), cvRound(point.y * factor)));
+    }
+
+    // Pad generously: the small copy only gives the corners to within a few pixels
+    cv::Rect region = cv::boundingRect(corners);
+    return PadRegion(region, std::max(region.width, region.height) / 4 + 2 * factor, image);
+}
+
+// Helper function to find one code's corners with detect() alone, on the
+// grayscale image and then on two cheap variants of it. Each pass is an
+// attempt in the "locate" cascade and counts against the budget.
+static bool LocateCode(const cv::Mat& image, const DetectOptions& options, const CascadeBudget& budget,
+                       std::vector<cv::Point2f>& corners, DetectionReport& report) {
+    static const char* const kLocateMethods[] = {"locate-original", "locate-equalize-hist", "locate-otsu"};
+
+    auto start = std::chrono::steady_clock::now();
+    cv::Mat gray = ToGray(image);
+    report.stats.grayMs += ElapsedMs(start);
+
+    cv::QRCodeDetector& qrDetector = ThreadDetector();
+    for (int i = 0; i < 3; i++) {
+        if (!CanContinue(budget, report)) {
+            return false;
+        }
+
+        start = std::chrono::steady_clock::now();
+        cv::Mat variant = gray;
+        if (i == 1) {
+            cv::equalizeHist(gray, variant);
+        } else if (i == 2) {
+            cv::threshold(gray, variant, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+        }
+        bool found = qrDetector.detect(variant, corners) && corners.size() == 4;
+        double ms = ElapsedMs(start);
+        report.methodsTried.push_back(kLocateMethods[i]);
+        RecordAttempt("locate", kLocateMethods[i], found, ms);
+        if (options.stats) {
+            report.stats.methods.push_back({kLocateMethods[i], ms, found});
+            report.stats.detectCalls++;
+        }
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pixels per module and quiet-zone modules of a rectified patch
+static const int kPatchModulePixels = 5;
+static const int kPatchQuietModules = 4;
+
+// A located code warped upright onto a square at kPatchModulePixels per module,
+// with a margin of the surrounding image as its quiet zone
+struct RectifiedPatch {
+    cv::Mat pixels;                     // grayscale
+    std::vector<cv::Point2f> corners;   // code corners in the patch
+};
+
+// Helper function to warp the quadrangle inside gray onto a side x side square
+// offset by margin on every side
+static cv::Mat WarpQuad(const cv::Mat& gray, const std::vector<cv::Point2f>& corners, int side, int margin) {
+    std::vector<cv::Point2f> target = {
+        cv::Point2f(static_cast<float>(margin), static_cast<float>(margin)),
+        cv::Point2f(static_cast<float>(margin + side), static_cast<float>(margin)),
+        cv::Point2f(static_cast<float>(margin + side), static_cast<float>(margin + side)),
+        cv::Point2f(static_cast<float>(margin), static_cast<float>(margin + side))
+    };
+    cv::Mat transform = cv::getPerspectiveTransform(corners, target);
+    cv::Mat warped;
+    cv::warpPerspective(gray, warped, transform, cv::Size(side + 2 * margin, side + 2 * margin),
+                        cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    return warped;
+}
+
+// Helper function to estimate the module count of an upright code filling the
+// binarized square: rows through the top-left finder pattern read dark, light,
+// dark, light, dark in a 1:1:3:1:1 ratio spanning 7 modules. Returns 0 when no
+// row matches.
+static int EstimateModules(const cv::Mat& binary) {
+    std::vector<double> widths;
+    for (int y = 0; y < binary.rows / 4; y++) {
+        const uchar* row = binary.ptr<uchar>(y);
+        int runs[5] = {0, 0, 0, 0, 0};
+        int run = 0;
+        bool dark = true;
+        for (int x = 0; x < binary.cols && run < 5; x++) {
+            if ((row[x] == 0) == dark) {
+                runs[run]++;
+            } else {
+                dark = !dark;
+                if (++run < 5) {
+                    runs[run] = 1;
+                }
+            }
+        }
+        if (run < 5 || runs[0] == 0) {
+            continue;
+        }
+
+        double module = (runs[0] + runs[1] + runs[2] + runs[3] + runs[4]) / 7.0;
+        const double expected[5] = {1, 1, 3, 1, 1};
+        bool matches = true;
+        for (int i = 0; i < 5 && matches; i++) {
+            matches = std::abs(runs[i] - expected[i] * module) < 0.7 * module;
+        }
+        if (matches) {
+            widths.push_back(7 * module);
+        }
+    }
+    if (widths.empty()) {
+        return 0;
+    }
+
+    std::nth_element(widths.begin(), widths.begin() + widths.size() / 2, widths.end());
+    double modules = binary.cols / (widths[widths.size() / 2] / 7.0);
+    int version = std::min(40, std::max(1, cvRound((modules - 17) / 4)));
+    return 17 + 4 * version;
+}
+
+// Helper function to straighten a located code into a patch sized by its
+// estimated module count, so the cascade runs on a few hundred pixels however
+// large the code is in the image
+static bool RectifyCode(const cv::Mat& image, const std::vector<cv::Point2f>& corners, RectifiedPatch& patch) {
+    double quadSide = 0;
+    for (size_t i = 0; i < corners.size(); i++) {
+        quadSide = std::max(quadSide, cv::norm(corners[i] - corners[(i + 1) % corners.size()]));
+    }
+    if (corners.size() != 4 || quadSide < 8) {
+        return false;
+    }
+
+    // Work on the region around the code only
+    cv::Rect region = cv::boundingRect(corners);
+    region = PadRegion(region, std::max(region.width, region.height) / 4 + 8, image);
+    if (region.empty()) {
+        return false;
+    }
+    cv::Mat gray = ToGray(image(region));
+    std::vector<cv::Point2f> local;
+    for (const cv::Point2f& corner : corners) {
+        local.push_back(corner - cv::Point2f(static_cast<float>(region.x), static_cast<float>(region.y)));
+    }
+
+    // Estimate the module count on an upright copy at up to a few pixels per module
+    int estimateSide = std::min(720, std::max(210, cvRound(quadSide)));
+    cv::Mat binary;
+    cv::threshold(WarpQuad(gray, local, estimateSide, 0), binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+    int modules = EstimateModules(binary);
+    int side = modules > 0 ? modules * kPatchModulePixels : std::min(600, std::max(105, cvRound(quadSide)));
+    int margin = modules > 0 ? kPatchQuietModules * kPatchModulePixels : side / 8;
+
+    // Shrink large codes with area averaging first; warping alone would alias
+    if (quadSide > 2.0 * side) {
+        double factor = 2.0 * side / quadSide;
+        cv::resize(gray, gray, cv::Size(), factor, factor, cv::INTER_AREA);
+        for (cv::Point2f& corner : local) {
+            corner = corner * factor;
+        }
+    }
+
+    patch.pixels = WarpQuad(gray, local, side, margin);
+    patch.corners = {
+        cv::Point2f(static_cast<float>(margin), static_cast<float>(margin)),
+        cv::Point2f(static_cast<float>(margin + side), static_cast<float>(margin)),
+        cv::Point2f(static_cast<float>(margin + side), static_cast<float>(margin + side)),
+        cv::Point2f(static_cast<float>(margin), static_cast<float>(margin + side))
+    };
+    return true;
+}
+
+// Helper function to prefix the methods recorded since the given counts
+static void PrefixMethods(DetectionReport& report, size_t triedBefore, size_t timedBefore,
+                          const std::string& prefix) {
+    for (size_t i = triedBefore; i < report.methodsTried.size(); i++) {
+        report.methodsTried[i] = prefix + report.methodsTried[i];
+    }
+    for (size_t i = timedBefore; i < report.stats.methods.size(); i++) {
+        report.stats.methods[i].method = prefix + report.stats.methods[i].method;
+    }
+    if (!report.stats.method.empty()) {
+        report.stats.method = prefix + report.stats.method;
+    }
+}
+
+// Helper function to decode a code located at corners, in image coordinates.
+// The cascade runs on the padded region around it, or with rectify on a
+// straightened patch of it, and every variant decodes at the known corners.
+// points are returned in image coordinates.
+static bool DecodeLocated(const std::string& cascade, const cv::Mat& image,
+                          const std::vector<cv::Point2f>& corners, const DetectOptions& options,
+                          const CascadeBudget& budget, std::string& data,
+                          std::vector<cv::Point>& points, DetectionReport& report) {
+    if (options.rectify) {
+        auto start = std::chrono::steady_clock::now();
+        RectifiedPatch patch;
+        bool rectified = RectifyCode(image, corners, patch);
+        if (options.stats) {
+            report.stats.methods.push_back({"rectify", ElapsedMs(start), rectified});
+        }
+        if (rectified) {
+            size_t triedBefore = report.methodsTried.size();
+            size_t timedBefore = report.stats.methods.size();
+            bool decoded = DecodeWithCascade(cascade, BuildSingleCascade, patch.pixels, options, budget,
+                                             data, points, report, patch.corners);
+            PrefixMethods(report, triedBefore, timedBefore, "rect:");
+            if (decoded) {
+                points = RoundCorners(corners);
+            }
+            return decoded;
+        }
+    }
+
+    cv::Rect region = cv::boundingRect(corners);
+    region = PadRegion(region, std::max(region.width, region.height) / 4 + 8, image);
+    if (region.empty()) {
+        return false;
+    }
+    std::vector<cv::Point2f> local;
+    for (const cv::Point2f& corner : corners) {
+        local.push_back(corner - cv::Point2f(static_cast<float>(region.x), static_cast<float>(region.y)));
+    }
+
+    size_t triedBefore = report.methodsTried.size();
+    size_t timedBefore = report.stats.methods.size();
+    bool decoded = DecodeWithCascade(cascade, BuildSingleCascade, image(region), options, budget,
+                                     data, points, report, local);
+    PrefixMethods(report, triedBefore, timedBefore, "roi:");
+    for (cv::Point& point : points) {
+        point += region.tl();
+    }
+    return decoded;
+}
+
+// Helper function to map corners found in the decoded image back to source coordinates
+static std::vector<cv::Point> ToSourceCorners(const std::vector<cv::Point>& corners, int reduction) {
+    std::vector<cv::Point> scaled;
+    for (const cv::Point& corner : corners) {
+        scaled.push_back(corner * reduction);
+    }
+    return scaled;
+}
+
+// Image the crops of one call are cut from. With cropColor the source is
+// decoded again at full resolution in color, but only once something is to be
+// cropped, and only once however many codes are cropped from it.
+class CropSource {
+public:
+    CropSource(const DecodedImage& image, const DetectOptions& options, DetectionStats& stats)
+        : image_(image), options_(options), stats_(stats) {}
+
+    // Padded region around corners in source coordinates, a view into the image
+    cv::Mat Region(const std::vector<cv::Point>& corners) {
+        bool reduced = image_.pixels.channels() == 1 || image_.reduction > 1;
+        if (options_.cropColor && reduced && image_.source && !image_.source->isRaw && !colorDecoded_) {
+            auto start = std::chrono::steady_clock::now();
+            color_ = DecodeEncoded(*image_.source, cv::IMREAD_COLOR);
+            stats_.decodeMs += ElapsedMs(start);
+            colorDecoded_ = true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        cv::Mat region;
+        if (!color_.empty()) {
+            region = CropQRCodeRegion(color_, corners);
+        } else {
+            std::vector<cv::Point> local;
+            for (const cv::Point& corner : corners) {
+                local.push_back(cv::Point(corner.x / image_.reduction, corner.y / image_.reduction));
+            }
+            region = CropQRCodeRegion(image_.pixels, local);
+        }
+        stats_.cropMs += ElapsedMs(start);
+        return region;
+    }
+
+private:
+    const DecodedImage& image_;
+    const DetectOptions& options_;
+    DetectionStats& stats_;
+    bool colorDecoded_ = false;
+    cv::Mat color_;
+};
+
+// Helper function to fill qrCodeImage and the kept crop region for the corners
+// of result, which are in source coordinates. Nothing is cropped unless the
+// options ask for an image or a handle.
+static void CropQRCode(CropSource& source, const DetectOptions& options, QRCodeResult& result,
+                       DetectionStats& stats) {
+    if (options.crop.format == CropFormat::None && !options.cropHandle) {
+        return;
+    }
+
+    cv::Mat region = source.Region(result.corners);
+    if (region.empty()) {
+        return;
+    }
+
+    if (options.crop.buffer) {
+        // Kept in the vector imencode fills, which the JS Buffer then wraps
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
+        if (EncodeQRCodeBytes(region, options.crop, *bytes, &stats)) {
+            result.qrCodeBytes = bytes;
+        }
+    } else {
+        result.qrCodeImage = EncodeQRCodeImage(region, options.crop, &stats);
+    }
+    if (options.crop.format == CropFormat::Raw || options.cropHandle) {
+        // Copied out so that the region outlives the decoded image
+        auto start = std::chrono::steady_clock::now();
+        result.cropRegion = region.clone();
+        stats.cropMs += ElapsedMs(start);
+    }
+}
+
+bool DetectQRCodeInImage(const DecodedImage& image, const DetectOptions& options,
+                         QRCodeResult& result, DetectionReport& report) {
+    CascadeBudget budget(options);
+    std::string decodedData;
+    std::vector<cv::Point> points;
+    bool decoded = false;
+
+    // Coarse-to-fine: locate on a small copy, then decode only the region around it
+    if (options.pyramid > 1) {
+        std::vector<cv::Point> located;
+        cv::Rect region = LocalizeOnPyramid(image.pixels, options.pyramid, options, located, report);
+        if (!region.empty()) {
+            size_t triedBefore = report.methodsTried.size();
+            size_t timedBefore = report.stats.methods.size();
+            decoded = DecodeWithCascade("single-roi", BuildSingleCascade, image.pixels(region), options,
+                                        budget, decodedData, points, report);
+            PrefixMethods(report, triedBefore, timedBefore, "roi:");
+            for (cv::Point& point : points) {
+                point += region.tl();
+            }
+        }
+    }
+
+    // Locate once, then decode the variants of the region around the code at
+    // its known corners. If nothing is located, or the located region does not
+    // decode (a wrong quad, or the code is elsewhere in the frame), the
+    // full-image cascade runs with whatever budget is left.
+    if (!decoded && options.localize) {
+        std::vector<cv::Point2f> corners;
+        if (LocateCode(image.pixels, options, budget, corners, report)) {
+            decoded = DecodeLocated("single-roi", image.pixels, corners, options, budget,
+                                    decodedData, points, report);
+        }
+    }
+
+    if (!decoded && !DecodeWithCascade("single", BuildSingleCascade, image.pixels, options,
+                                       budget, decodedData, points, report)) {
+        return false;
+    }
+
+    result.data = decodedData;
+    result.corners = ToSourceCorners(points, image.reduction);
+    CropSource cropSource(image, options, report.stats);
+    CropQRCode(cropSource, options, result, report.stats);
+    return true;
+}
+
+// Codes found so far by the multi-code passes, in image coordinates
+struct MultiScan {
+    std::vector<std::string> data;
+    std::vector<std::vector<cv::Point>> corners;
+    std::vector<std::vector<cv::Point>> undecoded;  // localized but not decoded
+};
+
+// Helper function to tell whether two quadrangles cover the same code
+static bool SameRegion(const std::vector<cv::Point>& a, const std::vector<cv::Point>& b) {
+    cv::Rect first = cv::boundingRect(a);
+    cv::Rect second = cv::boundingRect(b);
+    return (first & second).area() > 0.5 * std::min(first.area(), second.area());
+}
+
+// Helper function to add a decoded code unless the same payload was already
+// found in the same place; regions it covers no longer count as undecoded
+static bool AddDecoded(MultiScan& scan, const std::string& data, const std::vector<cv::Point>& corners) {
+    for (size_t i = 0; i < scan.data.size(); i++) {
+        if (scan.data[i] == data && SameRegion(scan.corners[i], corners)) {
+            return false;
+        }
+    }
+    scan.data.push_back(data);
+    scan.corners.push_back(corners);
+    scan.undecoded.erase(std::remove_if(scan.undecoded.begin(), scan.undecoded.end(),
+        [&corners](const std::vector<cv::Point>& region) { return SameRegion(region, corners); }),
+        scan.undecoded.end());
+    return true;
+}
+
+// Helper function to add a region that was localized but not decoded
+static void AddUndecoded(MultiScan& scan, const std::vector<cv::Point>& corners) {
+    for (const auto& known : scan.corners) {
+        if (SameRegion(known, corners)) {
+            return;
+        }
+    }
+    for (const auto& known : scan.undecoded) {
+        if (SameRegion(known, corners)) {
+            return;
+        }
+    }
+    scan.undecoded.push_back(corners);
+}
+
+// Output of one detectAndDecodeMulti call: payloads, empty when not decoded,
+// and four corners per code
+struct MultiResult {
+    std::vector<std::string> infos;
+    std::vector<cv::Point2f> points;
+};
+
+// Helper function to merge a detectAndDecodeMulti result found on a region at
+// offset, scaled by scale relative to the image. Returns the number of new codes.
+static size_t MergeMultiResult(const MultiResult& result, double scale, cv::Point offset, MultiScan& scan) {
+    size_t added = 0;
+    for (size_t i = 0; i < result.infos.size() && (i + 1) * 4 <= result.points.size(); i++) {
+        std::vector<cv::Point> corners;
+        for (size_t k = 0; k < 4; k++) {
+            const cv::Point2f& point = result.points[i * 4 + k];
+            corners.push_back(cv::Point(cvRound(point.x / scale), cvRound(point.y / scale)) + offset);
+        }
+        if (result.infos[i].empty()) {
+            AddUndecoded(scan, corners);
+        } else if (AddDecoded(scan, result.infos[i], corners)) {
+            added++;
+        }
+    }
+    return added;
+}
+
+// Helper function to account for one multi-code pass in the stats and report
+static void RecordMultiPass(const std::string& method, double ms, size_t added, const DetectOptions& options,
+                            DetectionReport& report) {
+    RecordAttempt("multiple", method, added > 0, ms);
+    report.methodsTried.push_back(method);
+    if (options.stats) {
+        report.stats.methods.push_back({method, ms, added > 0});
+        report.stats.detectCalls++;
+        if (added > 0 && report.stats.method.empty()) {
+            report.stats.method = method;
+        }
+    }
+}
+
+// Helper function to run detectAndDecodeMulti on one variant and merge what it
+// finds; scale is the variant size relative to the image. Returns true when
+// anything was localized.
+static bool RunMultiPass(cv::QRCodeDetector& qrDecoder, const std::string& method, const cv::Mat& variant,
+                         double scale, const DetectOptions& options, MultiScan& scan, DetectionReport& report) {
+    auto start = std::chrono::steady_clock::now();
+    MultiResult result;
+    qrDecoder.detectAndDecodeMulti(variant, result.infos, result.points);
+    size_t added = MergeMultiResult(result, scale, cv::Point(0, 0), scan);
+    RecordMultiPass(method, ElapsedMs(start), added, options, report);
+    return !result.infos.empty();
+}
+
+// Longest side of the overview pass that accompanies a tiled scan, and the
+// smallest code it can be trusted to find
+static const int kOverviewSide = 1600;
+static const int kOverviewMinCode = 40;
+
+// Helper function to split the image into overlapping tiles. Every code up to
+// the overlap in size lies entirely inside some tile; the overlap is chosen so
+// that anything larger is big enough for the downscaled overview pass.
+static std::vector<cv::Rect> TileRegions(const cv::Mat& image, int minCodeSize) {
+    int longSide = std::max(image.cols, image.rows);
+    int tileSide = std::max({512, 8 * minCodeSize, 4 * kOverviewMinCode * longSide / kOverviewSide});
+    int overlap = tileSide / 4;
+    int step = tileSide - overlap;
+
+    std::vector<cv::Rect> tiles;
+    for (int y = 0; y < image.rows; y += step) {
+        for (int x = 0; x < image.cols; x += step) {
+            // Keep the last row and column full size by aligning them to the edge
+            int left = std::max(0, std::min(x, image.cols - tileSide));
+            int top = std::max(0, std::min(y, image.rows - tileSide));
+            tiles.push_back(cv::Rect(left, top, tileSide, tileSide) & cv::Rect(0, 0, image.cols, image.rows));
+            if (x + tileSide >= image.cols) {
+                break;
+            }
+        }
+        if (y + tileSide >= image.rows) {
+            break;
+        }
+    }
+    return tiles;
+}
+
+// Helper function to scan overlapping tiles in parallel across cores, plus a
+// downscaled overview for codes too large to fit in a tile. Results are merged
+// in tile order, so the outcome does not depend on scheduling. Returns true
+// when anything was localized.
+static bool RunTiledPass(const cv::Mat& image, int minCodeSize, const DetectOptions& options, MultiScan& scan,
+                         DetectionReport& report) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<cv::Rect> tiles = TileRegions(image, minCodeSize);
+    std::vector<MultiResult> results(tiles.size() + 1);
+
+    double overviewScale = std::min(1.0, static_cast<double>(kOverviewSide) / std::max(image.cols, image.rows));
+    const int count = static_cast<int>(results.size());
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        cv::QRCodeDetector& qrDecoder = ThreadDetector();
+        for (int i = range.start; i < range.end; i++) {
+            MultiResult& result = results[i];
+            if (i < static_cast<int>(tiles.size())) {
+                qrDecoder.detectAndDecodeMulti(image(tiles[i]), result.infos, result.points);
+            } else if (overviewScale < 1.0) {
+                cv::Mat overview;
+                cv::resize(image, overview, cv::Size(), overviewScale, overviewScale, cv::INTER_AREA);
+                qrDecoder.detectAndDecodeMulti(overview, result.infos, result.points);
+            }
+        }
+    });
+
+    size_t added = 0;
+    bool localized = false;
+    for (size_t i = 0; i < results.size(); i++) {
+        bool isTile = i < tiles.size();
+        added += MergeMultiResult(results[i], isTile ? 1.0 : overviewScale,
+                                  isTile ? tiles[i].tl() : cv::Point(0, 0), scan);
+        localized = localized || !results[i].infos.empty();
+    }
+    RecordMultiPass("tiles", ElapsedMs(start), added, options, report);
+    return localized;
+}
+
+// Find every code with detectAndDecodeMulti. The preprocessing variants are
+// then scanned until nothing has been localized yet, and for as long as each
+// pass still adds codes, so a photo where the plain pass finds only some of
+// its codes gets variant passes for the rest. Regions that were localized but
+// not decoded then get the single-code cascade on a padded crop, instead of the
+// whole image. If no code was found at all, the single-code cascade runs on
+// the whole image, as detectQRCode would.
+std::vector<QRCodeResult> DetectMultipleQRCodesInImage(const DecodedImage& image, const DetectOptions& options,
+                                                       DetectionReport& report) {
+    CascadeBudget budget(options);
+    cv::QRCodeDetector& qrDecoder = ThreadDetector();
+    MultiScan scan;
+
+    bool localized = options.tiled
+        ? RunTiledPass(image.pixels, std::max(8, options.minCodeSize / image.reduction), options, scan, report)
+        : RunMultiPass(qrDecoder, "original", image.pixels, 1.0, options, scan, report);
+
+    if ((!localized || !scan.data.empty()) && CanContinue(budget, report)) {
+        auto start = std::chrono::steady_clock::now();
+        cv::Mat gray = ToGray(image.pixels);
+        report.stats.grayMs += ElapsedMs(start);
+
+        std::vector<CascadeAttempt> attempts = BuildMultipleCascade(gray, options);
+        std::vector<size_t> order(attempts.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        if (options.adaptiveOrder) {
+            std::vector<std::string> methods;
+            for (const CascadeAttempt& attempt : attempts) {
+                methods.push_back(attempt.method);
+            }
+            order = CascadeStats::Instance().Order("multiple", methods);
+        }
+
+        for (size_t index : order) {
+            if (!CanContinue(budget, report)) {
+                break;
+            }
+            const CascadeAttempt& attempt = attempts[index];
+            size_t found = scan.data.size();
+            bool passLocalized = RunMultiPass(qrDecoder, attempt.method, attempt.prepare(gray, report.stats.sharedMs),
+                                              attempt.scale, options, scan, report);
+            localized = localized || passLocalized;
+            if (localized && scan.data.size() == found) {
+                break;
+            }
+        }
+    }
+
+    // Per-region fallback for codes that were found but did not decode
+    std::vector<std::vector<cv::Point>> undecoded = scan.undecoded;
+    for (const auto& region : undecoded) {
+        if (!CanContinue(budget, report)) {
+            break;
+        }
+
+        cv::Rect crop = cv::boundingRect(region);
+        crop = PadRegion(crop, std::max(crop.width, crop.height) / 4 + 8, image.pixels);
+        if (crop.empty()) {
+            continue;
+        }
+
+        std::string data;
+        std::vector<cv::Point> points;
+        std::string method = report.stats.method;
+        report.stats.method.clear();
+        bool decoded = false;
+        if (options.localize) {
+            // Reuse the corners that located the code instead of searching the crop
+            std::vector<cv::Point2f> corners;
+            for (const cv::Point& point : region) {
+                corners.push_back(cv::Point2f(static_cast<float>(point.x), static_cast<float>(point.y)));
+            }
+            decoded = DecodeLocated("multiple-roi", image.pixels, corners, options, budget, data, points, report);
+        } else {
+            size_t triedBefore = report.methodsTried.size();
+            size_t timedBefore = report.stats.methods.size();
+            decoded = DecodeWithCascade("multiple-roi", BuildSingleCascade, image.pixels(crop), options,
+                                        budget, data, points, report);
+            PrefixMethods(report, triedBefore, timedBefore, "roi:");
+            for (cv::Point& point : points) {
+                point += crop.tl();
+            }
+        }
+        if (!method.empty()) {
+            report.stats.method = method;
+        }
+        if (decoded) {
+            AddDecoded(scan, data, points);
+        }
+    }
+
+    // Nothing decoded: fall back to the single-code cascade on the whole image,
+    // which finds codes detectAndDecodeMulti does not localize in any variant
+    if (scan.data.empty()) {
+        std::string data;
+        std::vector<cv::Point> points;
+        size_t triedBefore = report.methodsTried.size();
+        size_t timedBefore = report.stats.methods.size();
+        bool decoded = DecodeWithCascade("single", BuildSingleCascade, image.pixels, options, budget,
+                                         data, points, report);
+        PrefixMethods(report, triedBefore, timedBefore, "single:");
+        if (decoded) {
+            AddDecoded(scan, data, points);
+        }
+    }
+
+    std::vector<QRCodeResult> results;
+    CropSource cropSource(image, options, report.stats);
+    for (size_t i = 0; i < scan.data.size(); i++) {
+        QRCodeResult qrCode;
+        qrCode.data = scan.data[i];
+        qrCode.corners = ToSourceCorners(scan.corners[i], image.reduction);
+        CropQRCode(cropSource, options, qrCode, report.stats);
+        results.push_back(std::move(qrCode));
+    }
+    return results;
+}
+
+bool HasQRCodeInImage(const DecodedImage& image, const DetectOptions& options,
+                      std::vector<cv::Point>& corners, DetectionReport& report) {
+    // Reuse this thread's QR code detector
+    cv::QRCodeDetector& qrDecoder = ThreadDetector();
+
+    // A code found on the small copy is enough to answer
+    if (options.pyramid > 1 && !LocalizeOnPyramid(image.pixels, options.pyramid, options, corners, report).empty()) {
+        corners = ToSourceCorners(corners, image.reduction);
+        return true;
+    }
+
+    // Only detect, don't decode
+    std::chrono::steady_clock::time_point start;
+    if (options.stats) {
+        start = std::chrono::steady_clock::now();
+    }
+    bool detected = qrDecoder.detect(image.pixels, corners);
+    if (options.stats) {
+        report.stats.methods.push_back({"detect", ElapsedMs(start), detected});
+        report.stats.detectCalls++;
+    }
+    corners = ToSourceCorners(corners, image.reduction);
+    return detected;
+}
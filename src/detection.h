@@ -0,0 +1,194 @@
+#ifndef QR_DETECTION_H
+#define QR_DETECTION_H
+
+#include <opencv2/core.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Core detection routines. Nothing in here touches N-API, so every function
+// can run on a worker thread; the bindings convert the results to JS objects.
+
+// Layout of an already decoded frame; YUV formats are read as their luma plane
+enum class PixelFormat {
+    Gray,
+    RGB,
+    RGBA,
+    BGR,
+    NV12,
+    I420
+};
+
+// Image captured on the JS thread, decoded later on a worker thread.
+// data is not owned: the caller keeps the bytes alive until the decode is done.
+struct ImageSource {
+    bool isPath = false;
+    std::string path;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    // Raw pixels instead of an encoded image
+    bool isRaw = false;
+    PixelFormat format = PixelFormat::Gray;
+    int width = 0;
+    int height = 0;
+    size_t stride = 0;          // bytes per row of the first plane
+};
+
+// One image operation of a preprocessing step
+struct PipelineOp {
+    enum Kind { Clahe, Adaptive, Otsu, Bilateral, MorphClose, Sharpen, Resize, Gamma, Equalize };
+
+    Kind kind = Clahe;
+    double value = 0;           // clip limit, block size, kernel size, scale, gamma or filter diameter
+    double sigma = 75;          // bilateral color and space sigma
+    bool inverted = false;      // otsu: dark code on a light background
+};
+
+// Range of a gamma correction step, whether it comes from DetectOptions::gammas
+// or from a gamma op
+const double kMinGamma = 0.01;
+const double kMaxGamma = 100;
+
+inline bool IsValidGamma(double gamma) {
+    return gamma >= kMinGamma && gamma <= kMaxGamma;
+}
+
+// One attempt of the cascade: the ops are applied in order to the grayscale
+// image and the result is decoded
+struct PipelineStep {
+    std::string method;         // name in methodsTried and the stats, derived from the ops if empty
+    std::vector<PipelineOp> ops;
+    int onlyBelow = 0;          // skip unless the shorter image side is below this, 0 = always
+};
+
+// Preprocessing cascade described as data, in the order it is tried
+typedef std::vector<PipelineStep> Pipeline;
+
+// How qrCodeImage is returned: a data URL in one of the image formats, or the
+// raw pixels of the crop
+enum class CropFormat {
+    None,
+    PNG,
+    JPEG,
+    WebP,
+    Raw
+};
+
+struct CropEncoding {
+    CropFormat format = CropFormat::PNG;
+    int quality = 90;           // JPEG and WebP quality, 0-100
+    int compression = 9;        // PNG compression level, 0-9
+    bool buffer = false;        // keep the encoded bytes instead of building a data URL
+};
+
+// Per-call tuning of the preprocessing cascade
+struct DetectOptions {
+    bool parallel = false;      // evaluate cascade variants concurrently across cores
+    bool adaptiveOrder = true;  // reorder variants by observed hit rate per unit cost
+    double timeoutMs = 0;       // stop starting new attempts after this long, 0 = no limit
+    size_t maxAttempts = 0;     // detectAndDecode passes including the original, 0 = no limit
+    bool stats = false;         // collect per-method timings into DetectionReport::stats
+    bool grayDecode = false;    // decode luma only, skipping chroma upsampling and color conversion
+    int reduction = 1;          // decode at 1/2, 1/4 or 1/8 resolution (JPEG DCT scaling)
+    bool cropColor = false;     // cut qrCodeImage from a full-resolution color decode, made on a hit
+    CropEncoding crop;          // qrCodeImage encoding, PNG by default; CropFormat::None = no crop
+    bool cropHandle = false;    // keep the crop region so it can be encoded after the call
+    int pyramid = 0;            // locate on a 1/2 or 1/4 copy first and decode only that region, 0 = off
+    bool tiled = false;         // multi-code: scan overlapping tiles in parallel instead of the whole image
+    int minCodeSize = 48;       // smallest expected code side in pixels, sizes the tiles
+    std::vector<double> gammas = {0.5, 0.7, 1.5, 2.0};     // gamma correction steps of the cascade
+    bool gaussianThreshold = true;      // Gaussian-weighted adaptive thresholds; false for box means
+    std::shared_ptr<const Pipeline> pipeline;   // replaces the built-in cascades, null = built-in
+    bool localize = false;      // locate once with detect(), then decode variants of that region only
+    bool rectify = false;       // localize onto a straightened patch at a fixed resolution per module
+};
+
+// Time spent in one detectAndDecode attempt, including building its variant
+struct MethodTiming {
+    std::string method;
+    double ms;
+    bool hit;
+};
+
+// Image handed to the detection routines
+struct DecodedImage {
+    cv::Mat pixels;             // BGR or grayscale, possibly reduced
+    int reduction = 1;          // pixels is 1/reduction of the source size in each dimension
+    const ImageSource* source = nullptr;    // for decoding the crop lazily, may be null
+};
+
+// Per-stage timings. The stage totals are always measured since they feed the
+// process-wide metrics; methods, detectCalls and method need DetectOptions::stats.
+struct DetectionStats {
+    double decodeMs = 0;        // cv::imread / cv::imdecode
+    double grayMs = 0;          // grayscale conversion before the cascade
+    double sharedMs = 0;        // fused variant groups built for several attempts, not in methods
+    std::vector<MethodTiming> methods;
+    int detectCalls = 0;
+    std::string method;         // method that decoded, empty on a miss
+    double cropMs = 0;
+    double encodeMs = 0;        // image encoding of the crop
+    double base64Ms = 0;
+};
+
+// Per-call account of what the cascade did
+struct DetectionReport {
+    bool timedOut = false;
+    std::vector<std::string> methodsTried;
+    DetectionStats stats;
+};
+
+// Milliseconds elapsed since start on the monotonic clock
+inline double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A single decoded QR code
+struct QRCodeResult {
+    std::string data;
+    std::vector<cv::Point> corners;
+    std::string qrCodeImage;    // data:image/...;base64,... (empty unless encoded to an image format)
+    std::shared_ptr<std::vector<uint8_t>> qrCodeBytes;  // encoded image with CropEncoding::buffer
+    cv::Mat cropRegion;         // padded code region, kept for CropFormat::Raw and handles
+};
+
+// Decode the image source (file path or encoded bytes) as a BGR image, or as
+// grayscale and/or at reduced resolution as the options ask. Raw frames become
+// a grayscale image, wrapped without copying when possible. The result refers
+// to source, which has to outlive it. The decode time is recorded in stats
+// when it is not null.
+DecodedImage LoadImage(const ImageSource& source, const DetectOptions& options,
+                       DetectionStats* stats = nullptr);
+
+// Detect and decode a single QR code, running the preprocessing cascade on a miss.
+// Corners are always in source coordinates, whatever the decode reduction.
+bool DetectQRCodeInImage(const DecodedImage& image, const DetectOptions& options,
+                         QRCodeResult& result, DetectionReport& report);
+
+// Detect and decode QR codes using the shorter multi-code cascade
+std::vector<QRCodeResult> DetectMultipleQRCodesInImage(const DecodedImage& image, const DetectOptions& options,
+                                                       DetectionReport& report);
+
+// Locate a QR code without decoding it
+bool HasQRCodeInImage(const DecodedImage& image, const DetectOptions& options,
+                      std::vector<cv::Point>& corners, DetectionReport& report);
+
+// Crop the padded bounding box of the corners. The result is a view into image,
+// empty if there are fewer than four corners.
+cv::Mat CropQRCodeRegion(const cv::Mat& image, const std::vector<cv::Point>& corners);
+
+// Encode a cropped region in the PNG, JPEG or WebP format of the encoding.
+// Returns false for the other formats or if the encoder fails. The encode time
+// is added to stats when it is not null.
+bool EncodeQRCodeBytes(const cv::Mat& region, const CropEncoding& encoding, std::vector<uint8_t>& buffer,
+                       DetectionStats* stats = nullptr);
+
+// As EncodeQRCodeBytes, returned as a data URL; empty on failure. The base64
+// time is added to stats as well.
+std::string EncodeQRCodeImage(const cv::Mat& region, const CropEncoding& encoding,
+                              DetectionStats* stats = nullptr);
+
+#endif // QR_DETECTION_H
@@ -0,0 +1,300 @@
+#include "metrics.h"
+#include "worker_pool.h"
+
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+static const char* kOperationNames[] = {
+    "detectQRCode",
+    "detectMultipleQRCodes",
+    "hasQRCode"
+};
+
+const std::array<double, Histogram::kBucketCount>& Histogram::Bounds() {
+    static const std::array<double, kBucketCount> bounds = {
+        1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000,
+        std::numeric_limits<double>::infinity()
+    };
+    return bounds;
+}
+
+void Histogram::Observe(double ms) {
+    const auto& bounds = Bounds();
+    size_t bucket = 0;
+    while (bucket + 1 < kBucketCount && ms > bounds[bucket]) {
+        bucket++;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sumUs_.fetch_add(static_cast<uint64_t>(ms > 0 ? ms * 1000.0 : 0), std::memory_order_relaxed);
+}
+
+std::array<uint64_t, Histogram::kBucketCount> Histogram::Buckets() const {
+    std::array<uint64_t, kBucketCount> cumulative{};
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        total += buckets_[i].load(std::memory_order_relaxed);
+        cumulative[i] = total;
+    }
+    return cumulative;
+}
+
+Metrics& Metrics::Instance() {
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+void Metrics::RecordCall(Operation op, bool detected, bool timedOut, double detectMs,
+                         double decodeMs, double encodeMs) {
+    OperationMetrics& metrics = operations_[static_cast<size_t>(op)];
+    metrics.calls.fetch_add(1, std::memory_order_relaxed);
+    if (detected) {
+        metrics.hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        metrics.misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (timedOut) {
+        metrics.timedOut.fetch_add(1, std::memory_order_relaxed);
+    }
+    metrics.detectMs.Observe(detectMs);
+    decodeMs_.Observe(decodeMs);
+    if (encodeMs > 0) {
+        encodeMs_.Observe(encodeMs);
+    }
+}
+
+void Metrics::RecordError(Operation op) {
+    OperationMetrics& metrics = operations_[static_cast<size_t>(op)];
+    metrics.calls.fetch_add(1, std::memory_order_relaxed);
+    metrics.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::RecordRejected(Operation op) {
+    OperationMetrics& metrics = operations_[static_cast<size_t>(op)];
+    metrics.calls.fetch_add(1, std::memory_order_relaxed);
+    metrics.rejected.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::RecordQueueWait(double ms) {
+    queueWaitMs_.Observe(ms);
+}
+
+// Most method series per cascade; per-call gammas and pipeline step names make
+// method names open-ended, so any further ones are counted together as "other"
+static const size_t kMaxMethodsPerCascade = 256;
+
+void Metrics::RecordMethod(const std::string& cascade, const std::string& method, bool hit) {
+    std::lock_guard<std::mutex> lock(methodsMutex_);
+    std::map<std::string, MethodCounters>& methods = methods_[cascade];
+    bool known = methods.find(method) != methods.end();
+    MethodCounters& counters = known || methods.size() < kMaxMethodsPerCascade - 1 ? methods[method] : methods["other"];
+    counters.attempts++;
+    if (hit) {
+        counters.hits++;
+    }
+}
+
+std::map<std::string, std::map<std::string, Metrics::MethodCounters>> Metrics::MethodsSnapshot() const {
+    std::lock_guard<std::mutex> lock(methodsMutex_);
+    return methods_;
+}
+
+// Helper function to print a number without locale or exponent surprises
+static std::string FormatNumber(double value) {
+    if (value == std::numeric_limits<double>::infinity()) {
+        return "+Inf";
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+    return buffer;
+}
+
+// Helper function to quote a string for JSON, escaping control characters
+static std::string JsonString(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// Helper function to escape a Prometheus label value
+static std::string LabelValue(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void HistogramToJson(std::ostringstream& out, const Histogram& histogram) {
+    const auto& bounds = Histogram::Bounds();
+    auto buckets = histogram.Buckets();
+    out << "{\"buckets\":[";
+    for (size_t i = 0; i < Histogram::kBucketCount; i++) {
+        out << (i ? "," : "") << "{\"le\":";
+        if (i + 1 == Histogram::kBucketCount) {
+            out << "\"+Inf\"";
+        } else {
+            out << FormatNumber(bounds[i]);
+        }
+        out << ",\"count\":" << buckets[i] << "}";
+    }
+    out << "],\"count\":" << histogram.Count() << ",\"sumMs\":" << FormatNumber(histogram.SumMs()) << "}";
+}
+
+std::string Metrics::ToJson() const {
+    std::ostringstream out;
+    out << "{\"operations\":{";
+    for (size_t i = 0; i < operations_.size(); i++) {
+        const OperationMetrics& metrics = operations_[i];
+        out << (i ? "," : "") << JsonString(kOperationNames[i]) << ":{"
+            << "\"calls\":" << metrics.calls.load()
+            << ",\"hits\":" << metrics.hits.load()
+            << ",\"misses\":" << metrics.misses.load()
+            << ",\"errors\":" << metrics.errors.load()
+            << ",\"rejected\":" << metrics.rejected.load()
+            << ",\"timedOut\":" << metrics.timedOut.load()
+            << ",\"detectMs\":";
+        HistogramToJson(out, metrics.detectMs);
+        out << "}";
+    }
+    out << "},\"decodeMs\":";
+    HistogramToJson(out, decodeMs_);
+    out << ",\"encodeMs\":";
+    HistogramToJson(out, encodeMs_);
+    out << ",\"queueWaitMs\":";
+    HistogramToJson(out, queueWaitMs_);
+
+    out << ",\"methods\":{";
+    bool firstCascade = true;
+    for (const auto& cascade : MethodsSnapshot()) {
+        out << (firstCascade ? "" : ",") << JsonString(cascade.first) << ":[";
+        firstCascade = false;
+        bool firstMethod = true;
+        for (const auto& method : cascade.second) {
+            out << (firstMethod ? "" : ",") << "{\"method\":" << JsonString(method.first)
+                << ",\"attempts\":" << method.second.attempts
+                << ",\"hits\":" << method.second.hits << "}";
+            firstMethod = false;
+        }
+        out << "]";
+    }
+    out << "}";
+
+    WorkerPoolStats pool = WorkerPool::Instance().Stats();
+    out << ",\"pool\":{\"threads\":" << pool.threads
+        << ",\"maxQueue\":" << pool.maxQueue
+        << ",\"maxWaiting\":" << pool.maxWaiting
+        << ",\"queued\":" << pool.queued
+        << ",\"waiting\":" << pool.waiting
+        << ",\"active\":" << pool.active
+        << ",\"completed\":" << pool.completed
+        << ",\"rejected\":" << pool.rejected << "}}";
+    return out.str();
+}
+
+// Histograms are exported in seconds, following Prometheus conventions
+static void HistogramToPrometheus(std::ostringstream& out, const std::string& name,
+                                  const std::string& labels, const Histogram& histogram) {
+    const auto& bounds = Histogram::Bounds();
+    auto buckets = histogram.Buckets();
+    std::string separator = labels.empty() ? "" : ",";
+    for (size_t i = 0; i < Histogram::kBucketCount; i++) {
+        out << name << "_bucket{" << labels << separator << "le=\""
+            << FormatNumber(bounds[i] / 1000.0) << "\"} " << buckets[i] << "\n";
+    }
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << suffix << " " << FormatNumber(histogram.SumMs() / 1000.0) << "\n";
+    out << name << "_count" << suffix << " " << histogram.Count() << "\n";
+}
+
+std::string Metrics::ToPrometheus() const {
+    std::ostringstream out;
+
+    out << "# HELP qr_detector_calls_total Detection calls by function and outcome.\n";
+    out << "# TYPE qr_detector_calls_total counter\n";
+    for (size_t i = 0; i < operations_.size(); i++) {
+        const OperationMetrics& metrics = operations_[i];
+        std::string function = std::string("function=\"") + kOperationNames[i] + "\"";
+        out << "qr_detector_calls_total{" << function << ",outcome=\"hit\"} " << metrics.hits.load() << "\n";
+        out << "qr_detector_calls_total{" << function << ",outcome=\"miss\"} " << metrics.misses.load() << "\n";
+        out << "qr_detector_calls_total{" << function << ",outcome=\"error\"} " << metrics.errors.load() << "\n";
+        out << "qr_detector_calls_total{" << function << ",outcome=\"rejected\"} " << metrics.rejected.load() << "\n";
+    }
+
+    out << "# HELP qr_detector_timeouts_total Calls whose cascade stopped at the timeoutMs deadline.\n";
+    out << "# TYPE qr_detector_timeouts_total counter\n";
+    for (size_t i = 0; i < operations_.size(); i++) {
+        out << "qr_detector_timeouts_total{function=\"" << kOperationNames[i] << "\"} "
+            << operations_[i].timedOut.load() << "\n";
+    }
+
+    out << "# HELP qr_detector_detect_duration_seconds Time per call after the image is decoded, including the crop encoding.\n";
+    out << "# TYPE qr_detector_detect_duration_seconds histogram\n";
+    for (size_t i = 0; i < operations_.size(); i++) {
+        HistogramToPrometheus(out, "qr_detector_detect_duration_seconds",
+                              std::string("function=\"") + kOperationNames[i] + "\"",
+                              operations_[i].detectMs);
+    }
+
+    out << "# HELP qr_detector_decode_duration_seconds Time spent decoding the input image.\n";
+    out << "# TYPE qr_detector_decode_duration_seconds histogram\n";
+    HistogramToPrometheus(out, "qr_detector_decode_duration_seconds", "", decodeMs_);
+
+    out << "# HELP qr_detector_encode_duration_seconds Time spent cropping and encoding qrCodeImage.\n";
+    out << "# TYPE qr_detector_encode_duration_seconds histogram\n";
+    HistogramToPrometheus(out, "qr_detector_encode_duration_seconds", "", encodeMs_);
+
+    out << "# HELP qr_detector_queue_wait_seconds Time jobs spent waiting for a pool thread.\n";
+    out << "# TYPE qr_detector_queue_wait_seconds histogram\n";
+    HistogramToPrometheus(out, "qr_detector_queue_wait_seconds", "", queueWaitMs_);
+
+    auto cascades = MethodsSnapshot();
+    out << "# HELP qr_detector_method_attempts_total Preprocessing attempts by cascade and method.\n";
+    out << "# TYPE qr_detector_method_attempts_total counter\n";
+    for (const auto& cascade : cascades) {
+        for (const auto& method : cascade.second) {
+            out << "qr_detector_method_attempts_total{cascade=\"" << LabelValue(cascade.first)
+                << "\",method=\"" << LabelValue(method.first) << "\"} " << method.second.attempts << "\n";
+        }
+    }
+    out << "# HELP qr_detector_method_hits_total Successful decodes by cascade and method.\n";
+    out << "# TYPE qr_detector_method_hits_total counter\n";
+    for (const auto& cascade : cascades) {
+        for (const auto& method : cascade.second) {
+            out << "qr_detector_method_hits_total{cascade=\"" << LabelValue(cascade.first)
+                << "\",method=\"" << LabelValue(method.first) << "\"} " << method.second.hits << "\n";
+        }
+    }
+
+    WorkerPoolStats pool = WorkerPool::Instance().Stats();
+    out << "# HELP qr_detector_pool_queued Jobs waiting for a pool thread.\n";
+    out << "# TYPE qr_detector_pool_queued gauge\n";
+    out << "qr_detector_pool_queued " << pool.queued << "\n";
+    out << "# HELP qr_detector_pool_waiting Jobs parked by the wait policy until the queue has room.\n";
+    out << "# TYPE qr_detector_pool_waiting gauge\n";
+    out << "qr_detector_pool_waiting " << pool.waiting << "\n";
+    out << "# HELP qr_detector_pool_active Jobs running on pool threads.\n";
+    out << "# TYPE qr_detector_pool_active gauge\n";
+    out << "qr_detector_pool_active " << pool.active << "\n";
+
+    return out.str();
+}
@@ -0,0 +1,88 @@
+#ifndef QR_METRICS_H
+#define QR_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Exported entry points that metrics are broken down by
+enum class Operation {
+    DetectQRCode = 0,
+    DetectMultipleQRCodes,
+    HasQRCode,
+    Count
+};
+
+// Latency histogram with fixed millisecond buckets, safe to update from any thread
+class Histogram {
+public:
+    static constexpr size_t kBucketCount = 14;
+    static const std::array<double, kBucketCount>& Bounds();   // upper bounds in ms
+
+    void Observe(double ms);
+
+    // Cumulative bucket counts; the last bound is +Inf
+    std::array<uint64_t, kBucketCount> Buckets() const;
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    double SumMs() const { return sumUs_.load(std::memory_order_relaxed) / 1000.0; }
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sumUs_{0};
+};
+
+// Process-wide counters and latency histograms for every entry point. Updates
+// are lock-free apart from the per-method counters; exports also include the
+// worker pool gauges.
+class Metrics {
+public:
+    static Metrics& Instance();
+
+    void RecordCall(Operation op, bool detected, bool timedOut, double detectMs,
+                    double decodeMs, double encodeMs);
+    void RecordError(Operation op);
+    void RecordRejected(Operation op);
+    void RecordQueueWait(double ms);
+
+    // One preprocessing attempt. Kept apart from CascadeStats, which callers
+    // can reset or overwrite, so these counters only ever grow. The number of
+    // methods per cascade is capped, with the rest counted as "other".
+    void RecordMethod(const std::string& cascade, const std::string& method, bool hit);
+
+    std::string ToJson() const;
+    std::string ToPrometheus() const;
+
+private:
+    struct OperationMetrics {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> timedOut{0};
+        Histogram detectMs;
+    };
+
+    struct MethodCounters {
+        uint64_t attempts = 0;
+        uint64_t hits = 0;
+    };
+
+    Metrics() = default;
+
+    std::map<std::string, std::map<std::string, MethodCounters>> MethodsSnapshot() const;
+
+    std::array<OperationMetrics, static_cast<size_t>(Operation::Count)> operations_;
+    Histogram decodeMs_;
+    Histogram encodeMs_;
+    Histogram queueWaitMs_;
+    mutable std::mutex methodsMutex_;
+    std::map<std::string, std::map<std::string, MethodCounters>> methods_;
+};
+
+#endif // QR_METRICS_H
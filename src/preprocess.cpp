@@ -0,0 +1,297 @@
+#include "preprocess.h"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Rows handed to a thread at a time by ApplyTables; a strip of a 4K wide image
+// is 256KB of source, so it stays in L2 while every table is applied
+static const int kStripRows = 64;
+
+GrayHistogram ComputeHistogram(const cv::Mat& gray) {
+    CV_Assert(gray.type() == CV_8UC1);
+
+    // Four interleaved counters so runs of equal pixels don't serialize on one bin
+    uint32_t partial[4][256] = {};
+    for (int y = 0; y < gray.rows; y++) {
+        const uchar* row = gray.ptr<uchar>(y);
+        int x = 0;
+        for (; x + 4 <= gray.cols; x += 4) {
+            partial[0][row[x]]++;
+            partial[1][row[x + 1]]++;
+            partial[2][row[x + 2]]++;
+            partial[3][row[x + 3]]++;
+        }
+        for (; x < gray.cols; x++) {
+            partial[0][row[x]]++;
+        }
+    }
+
+    GrayHistogram histogram;
+    for (int i = 0; i < 256; i++) {
+        histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+    }
+    return histogram;
+}
+
+// Same between-class variance search as OpenCV's getThreshVal_Otsu_8u, so the
+// binarization matches cv::threshold bit for bit
+int OtsuThreshold(const GrayHistogram& histogram) {
+    double total = 0;
+    for (uint32_t count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    double scale = 1.0 / total;
+    double mu = 0;
+    for (int i = 0; i < 256; i++) {
+        mu += i * static_cast<double>(histogram[i]);
+    }
+    mu *= scale;
+
+    double mu1 = 0, q1 = 0;
+    double maxSigma = 0;
+    int threshold = 0;
+    for (int i = 0; i < 256; i++) {
+        double p = histogram[i] * scale;
+        mu1 *= q1;
+        q1 += p;
+        double q2 = 1.0 - q1;
+
+        if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1.0 - FLT_EPSILON) {
+            continue;
+        }
+
+        mu1 = (mu1 + i * p) / q1;
+        double mu2 = (mu - q1 * mu1) / q2;
+        double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > maxSigma) {
+            maxSigma = sigma;
+            threshold = i;
+        }
+    }
+    return threshold;
+}
+
+// Same cumulative mapping as cv::equalizeHist
+cv::Mat EqualizeTable(const GrayHistogram& histogram) {
+    cv::Mat table(1, 256, CV_8U, cv::Scalar(0));
+    uchar* lut = table.ptr<uchar>();
+
+    uint64_t total = 0;
+    for (uint32_t count : histogram) {
+        total += count;
+    }
+    int first = 0;
+    while (first < 256 && histogram[first] == 0) {
+        first++;
+    }
+    if (first == 256) {
+        return table;
+    }
+    if (histogram[first] == total) {
+        // Flat image: equalizeHist leaves it as it is
+        for (int i = 0; i < 256; i++) {
+            lut[i] = static_cast<uchar>(first);
+        }
+        return table;
+    }
+
+    float scale = (256 - 1.f) / (total - histogram[first]);
+    uint64_t sum = 0;
+    for (int i = first + 1; i < 256; i++) {
+        sum += histogram[i];
+        lut[i] = cv::saturate_cast<uchar>(sum * scale);
+    }
+    return table;
+}
+
+cv::Mat ThresholdTable(int threshold, bool inverted) {
+    cv::Mat table(1, 256, CV_8U);
+    uchar* lut = table.ptr<uchar>();
+    for (int i = 0; i < 256; i++) {
+        lut[i] = (i > threshold) != inverted ? 255 : 0;
+    }
+    return table;
+}
+
+std::vector<cv::Mat> ApplyTables(const cv::Mat& gray, const std::vector<cv::Mat>& tables) {
+    CV_Assert(gray.type() == CV_8UC1);
+
+    std::vector<cv::Mat> planes;
+    std::vector<const uchar*> luts;
+    for (const cv::Mat& table : tables) {
+        CV_Assert(table.type() == CV_8UC1 && table.total() == 256 && table.isContinuous());
+        planes.push_back(cv::Mat(gray.size(), CV_8UC1));
+        luts.push_back(table.ptr<uchar>());
+    }
+    if (planes.empty() || gray.empty()) {
+        return planes;
+    }
+
+    const int width = gray.cols;
+    const int strips = (gray.rows + kStripRows - 1) / kStripRows;
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        int endRow = std::min(gray.rows, range.end * kStripRows);
+        for (int y = range.start * kStripRows; y < endRow; y++) {
+            const uchar* src = gray.ptr<uchar>(y);
+            for (size_t k = 0; k < luts.size(); k++) {
+                const uchar* lut = luts[k];
+                uchar* dst = planes[k].ptr<uchar>(y);
+                int x = 0;
+                for (; x + 4 <= width; x += 4) {
+                    uchar a = lut[src[x]], b = lut[src[x + 1]];
+                    uchar c = lut[src[x + 2]], d = lut[src[x + 3]];
+                    dst[x] = a;
+                    dst[x + 1] = b;
+                    dst[x + 2] = c;
+                    dst[x + 3] = d;
+                }
+                for (; x < width; x++) {
+                    dst[x] = lut[src[x]];
+                }
+            }
+        }
+    }, strips);
+    return planes;
+}
+
+// Helper function to threshold one row against its box sums. Each sum is
+// right[x] - left[x], two entries of a running sum of the row's column sums
+// already offset to the box edges; the running sum wraps around at 2^32,
+// which leaves box sums exact.
+static void ThresholdRow(const uchar* src, const uint32_t* left, const uint32_t* right,
+                         uint32_t area, int delta, uchar* dst, int width) {
+    int x = 0;
+#if defined(__SSE2__)
+    // (src + delta) * area > sum, 16 pixels at a time. area and src + delta both
+    // fit in 16 bits, so madd against (area, 0) pairs gives the 32-bit product.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i offset = _mm_set1_epi16(static_cast<short>(delta));
+    const __m128i scale = _mm_set1_epi32(static_cast<int>(area));
+    for (; x + 16 <= width; x += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(pixels, zero), offset);
+        __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(pixels, zero), offset);
+        __m128i words[4] = {
+            _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+            _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)
+        };
+        __m128i masks[4];
+        for (int i = 0; i < 4; i++) {
+            int at = x + 4 * i;
+            __m128i sum = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(right + at)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + at)));
+            masks[i] = _mm_cmpgt_epi32(_mm_madd_epi16(words[i], scale), sum);
+        }
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(masks[0], masks[1]),
+                                         _mm_packs_epi32(masks[2], masks[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+#elif defined(__ARM_NEON)
+    const uint16x8_t offset = vdupq_n_u16(static_cast<uint16_t>(delta));
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t pixels = vld1q_u8(src + x);
+        uint16x8_t halves[2] = {
+            vaddq_u16(vmovl_u8(vget_low_u8(pixels)), offset),
+            vaddq_u16(vmovl_u8(vget_high_u8(pixels)), offset)
+        };
+        uint16x4_t masks[4];
+        for (int i = 0; i < 4; i++) {
+            int at = x + 4 * i;
+            uint32x4_t sum = vsubq_u32(vld1q_u32(right + at), vld1q_u32(left + at));
+            uint16x4_t half = i % 2 ? vget_high_u16(halves[i / 2]) : vget_low_u16(halves[i / 2]);
+            masks[i] = vmovn_u32(vcgtq_u32(vmulq_n_u32(vmovl_u16(half), area), sum));
+        }
+        uint8x16_t packed = vcombine_u8(vmovn_u16(vcombine_u16(masks[0], masks[1])),
+                                        vmovn_u16(vcombine_u16(masks[2], masks[3])));
+        vst1q_u8(dst + x, packed);
+    }
+#endif
+    for (; x < width; x++) {
+        uint32_t sum = right[x] - left[x];
+        dst[x] = static_cast<uint32_t>(src[x] + delta) * area > sum ? 255 : 0;
+    }
+}
+
+std::vector<cv::Mat> MeanAdaptiveThresholds(const cv::Mat& gray, const std::vector<int>& blockSizes,
+                                            int delta) {
+    CV_Assert(gray.type() == CV_8UC1 && delta >= 0 && delta < 256);
+
+    std::vector<cv::Mat> binaries;
+    int radius = 0;
+    for (int blockSize : blockSizes) {
+        CV_Assert(blockSize % 2 == 1 && blockSize > 1 && blockSize <= 181);
+        radius = std::max(radius, blockSize / 2);
+        binaries.push_back(cv::Mat(gray.size(), CV_8UC1));
+    }
+    if (binaries.empty() || gray.empty()) {
+        return binaries;
+    }
+
+    // Rows are padded by the largest radius with replicated borders
+    const int width = gray.cols;
+    const int paddedCols = width + 2 * radius;
+    std::vector<int> sourceCol(paddedCols);
+    for (int px = 0; px < paddedCols; px++) {
+        sourceCol[px] = std::min(std::max(px - radius, 0), width - 1);
+    }
+    auto sourceRow = [&](int y) {
+        return gray.ptr<uchar>(std::min(std::max(y, 0), gray.rows - 1));
+    };
+
+    // Instead of an integral image of the whole frame, each thread keeps one
+    // row of column sums per block size, covering the block's rows around the
+    // current row, and slides it down its strips one row at a time
+    const int strips = (gray.rows + kStripRows - 1) / kStripRows;
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        const int startRow = range.start * kStripRows;
+        const int endRow = std::min(gray.rows, range.end * kStripRows);
+        std::vector<std::vector<uint32_t>> columns(blockSizes.size(), std::vector<uint32_t>(width, 0));
+        std::vector<uint32_t> running(paddedCols + 1, 0);
+
+        for (size_t k = 0; k < blockSizes.size(); k++) {
+            int r = blockSizes[k] / 2;
+            for (int dy = -r; dy <= r; dy++) {
+                const uchar* row = sourceRow(startRow + dy);
+                for (int x = 0; x < width; x++) {
+                    columns[k][x] += row[x];
+                }
+            }
+        }
+
+        for (int y = startRow; y < endRow; y++) {
+            const uchar* src = gray.ptr<uchar>(y);
+            for (size_t k = 0; k < blockSizes.size(); k++) {
+                int r = blockSizes[k] / 2;
+                uint32_t* column = columns[k].data();
+                if (y > startRow) {
+                    const uchar* entering = sourceRow(y + r);
+                    const uchar* leaving = sourceRow(y - r - 1);
+                    for (int x = 0; x < width; x++) {
+                        column[x] += entering[x] - leaving[x];
+                    }
+                }
+
+                uint32_t sum = 0;
+                for (int px = 0; px < paddedCols; px++) {
+                    sum += column[sourceCol[px]];
+                    running[px + 1] = sum;
+                }
+                ThresholdRow(src, &running[radius - r], &running[radius + r + 1],
+                             static_cast<uint32_t>(blockSizes[k] * blockSizes[k]), delta,
+                             binaries[k].ptr<uchar>(y), width);
+            }
+        }
+    }, strips);
+    return binaries;
+}
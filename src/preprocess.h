@@ -0,0 +1,40 @@
+#ifndef QR_PREPROCESS_H
+#define QR_PREPROCESS_H
+
+#include <opencv2/core.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// 256-bin histogram of an 8-bit single-channel image
+typedef std::array<uint32_t, 256> GrayHistogram;
+
+// Counts the gray levels of an 8-bit single-channel image in one read
+GrayHistogram ComputeHistogram(const cv::Mat& gray);
+
+// Otsu threshold for the histogram, identical to the value cv::threshold picks
+// with THRESH_OTSU; pixels above it are foreground
+int OtsuThreshold(const GrayHistogram& histogram);
+
+// Lookup tables equivalent to cv::equalizeHist and to binary / inverted binary
+// thresholding at the given level
+cv::Mat EqualizeTable(const GrayHistogram& histogram);
+cv::Mat ThresholdTable(int threshold, bool inverted);
+
+// Applies every 1x256 CV_8U table to gray in a single pass. Rows are processed
+// in strips, and each source row is read into cache once and then written out
+// through all the tables, instead of streaming the whole image once per table.
+std::vector<cv::Mat> ApplyTables(const cv::Mat& gray, const std::vector<cv::Mat>& tables);
+
+// Mean adaptive thresholds for several odd block sizes at once: a pixel is 255
+// when it is brighter than the exact mean of its blockSize x blockSize
+// neighbourhood minus delta, borders replicated. This is close to
+// cv::adaptiveThreshold with ADAPTIVE_THRESH_MEAN_C and THRESH_BINARY, but not
+// identical: OpenCV rounds the mean to 8 bits before comparing, so pixels
+// within half a gray level of it can differ. Box sums come from column sums
+// that slide down each strip, so memory stays at a few rows per thread, and
+// each row is thresholded for all sizes while it is in cache.
+std::vector<cv::Mat> MeanAdaptiveThresholds(const cv::Mat& gray, const std::vector<int>& blockSizes,
+                                            int delta);
+
+#endif // QR_PREPROCESS_H
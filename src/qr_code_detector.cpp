@@ -1,544 +1,1365 @@
 #include <napi.h>
 #include <opencv2/opencv.hpp>
-#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <vector>
 #include <string>
 
-// Helper function to read image from buffer
-cv::Mat readImageFromBuffer(const Napi::Buffer<uint8_t>& buffer) {
-    std::vector<uint8_t> vec(buffer.Data(), buffer.Data() + buffer.Length());
-    return cv::imdecode(vec, cv::IMREAD_COLOR);
+#include "cascade_stats.h"
+#include "detection.h"
+#include "metrics.h"
+#include "worker_pool.h"
+
+// Helper function to parse a raw pixel frame { data, width, height, stride, format }
+static bool GetPixelSource(Napi::Env env, Napi::Object frame, ImageSource& source, Napi::Object* owner) {
+    static const std::map<std::string, std::pair<PixelFormat, int>> formats = {
+        {"gray", {PixelFormat::Gray, 1}},
+        {"rgb", {PixelFormat::RGB, 3}},
+        {"rgba", {PixelFormat::RGBA, 4}},
+        {"bgr", {PixelFormat::BGR, 3}},
+        {"nv12", {PixelFormat::NV12, 1}},
+        {"i420", {PixelFormat::I420, 1}}
+    };
+
+    Napi::Value data = frame.Get("data");
+    if (!data.IsTypedArray() ||
+        (data.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array &&
+         data.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_clamped_array)) {
+        Napi::TypeError::New(env, "data must be a Buffer, Uint8Array or Uint8ClampedArray").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value format = frame.Get("format");
+    auto found = formats.find(format.IsString() ? format.As<Napi::String>().Utf8Value() : "");
+    if (found == formats.end()) {
+        Napi::TypeError::New(env, "format must be 'gray', 'rgb', 'rgba', 'bgr', 'nv12' or 'i420'").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    // Rows of pixels and the stride have to fit the int sizes of a cv::Mat
+    const int64_t bytesPerPixel = found->second.second;
+    Napi::Value width = frame.Get("width");
+    Napi::Value height = frame.Get("height");
+    if (!width.IsNumber() || !height.IsNumber() ||
+        width.As<Napi::Number>().Int64Value() < 1 || height.As<Napi::Number>().Int64Value() < 1 ||
+        width.As<Napi::Number>().Int64Value() > INT_MAX / bytesPerPixel ||
+        height.As<Napi::Number>().Int64Value() > INT_MAX) {
+        Napi::TypeError::New(env, "width and height must be positive numbers, with width * bytes per pixel "
+                             "and height below 2^31").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    source.isRaw = true;
+    source.format = found->second.first;
+    source.width = static_cast<int>(width.As<Napi::Number>().Int64Value());
+    source.height = static_cast<int>(height.As<Napi::Number>().Int64Value());
+    size_t rowBytes = static_cast<size_t>(source.width) * static_cast<size_t>(bytesPerPixel);
+    source.stride = rowBytes;
+
+    Napi::Value stride = frame.Get("stride");
+    if (!stride.IsUndefined()) {
+        if (!stride.IsNumber() || stride.As<Napi::Number>().Int64Value() < static_cast<int64_t>(rowBytes) ||
+            stride.As<Napi::Number>().Int64Value() > INT_MAX) {
+            Napi::TypeError::New(env, "stride must be at least width * bytes per pixel and below 2^31")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        source.stride = static_cast<size_t>(stride.As<Napi::Number>().Int64Value());
+    }
+
+    // Only the first plane is read, which for YUV formats is the luma plane.
+    // The bound is checked by division so a large stride cannot wrap it.
+    Napi::TypedArray array = data.As<Napi::TypedArray>();
+    source.data = static_cast<const uint8_t*>(array.ArrayBuffer().Data()) + array.ByteOffset();
+    source.size = array.ByteLength();
+    if (source.size < rowBytes ||
+        (source.height > 1 && source.stride > (source.size - rowBytes) / static_cast<size_t>(source.height - 1))) {
+        Napi::TypeError::New(env, "data is too small for width, height and stride").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (owner) {
+        *owner = array;
+    }
+    return true;
 }
 
-// Main QR code detection function
-Napi::Object DetectQRCode(const Napi::CallbackInfo& info) {
+// Helper function to capture the image argument (path, buffer or raw pixel frame).
+// Pixels and buffers are not copied; owner receives the object that has to be
+// kept alive until decoding is done.
+bool GetImageSource(const Napi::CallbackInfo& info, ImageSource& source, Napi::Object* owner = nullptr) {
     Napi::Env env = info.Env();
-    cv::Mat image;
 
-    try {
-        // Validate input
-        if (info.Length() < 1) {
-            Napi::TypeError::New(env, "Expected an image path or buffer").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+    // Validate input
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Expected an image path or buffer").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (info[0].IsString()) {
+        source.isPath = true;
+        source.path = info[0].As<Napi::String>().Utf8Value();
+    } else if (info[0].IsBuffer()) {
+        Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
+        // The decoder takes the length as an int
+        if (buffer.Length() > static_cast<size_t>(INT_MAX)) {
+            Napi::TypeError::New(env, "Encoded image buffers must be smaller than 2GB").ThrowAsJavaScriptException();
+            return false;
+        }
+        source.data = buffer.Data();
+        source.size = buffer.Length();
+        if (owner) {
+            *owner = buffer;
         }
+    } else if (info[0].IsObject() && !info[0].IsArray()) {
+        return GetPixelSource(env, info[0].As<Napi::Object>(), source, owner);
+    } else {
+        Napi::TypeError::New(env, "Expected string, buffer or pixel frame argument").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
+}
 
-        // Read input image
-        if (info[0].IsString()) {
-            std::string imagePath = info[0].As<Napi::String>().Utf8Value();
-            image = cv::imread(imagePath, cv::IMREAD_COLOR);
-        } else if (info[0].IsBuffer()) {
-            Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
-            image = readImageFromBuffer(buffer);
+// Most steps a pipeline may expand to
+static const size_t kMaxPipelineSteps = 64;
+
+// Pipeline set with setPipeline(), shared by every addon instance; null = built-in cascades
+struct GlobalPipeline {
+    std::mutex mutex;
+    std::shared_ptr<const Pipeline> pipeline;
+
+    static GlobalPipeline& Instance() {
+        static GlobalPipeline* global = new GlobalPipeline();
+        return *global;
+    }
+};
+
+// Crop regions handed out as cropHandle externals. encodeQRCodeImage() only
+// dereferences pointers registered here, so any other External is rejected.
+struct CropHandles {
+    std::mutex mutex;
+    std::set<const cv::Mat*> live;
+
+    static CropHandles& Instance() {
+        static CropHandles* handles = new CropHandles();
+        return *handles;
+    }
+};
+
+// Helper function to parse an image format, its quality / compression level and
+// whether to return a Buffer from object under the given keys; encoding keeps
+// its defaults for absent keys
+static bool GetCropEncoding(Napi::Env env, Napi::Object object, const char* formatKey,
+                            const char* qualityKey, const char* compressionKey, const char* bufferKey,
+                            CropEncoding& encoding) {
+    static const std::map<std::string, CropFormat> formats = {
+        {"png", CropFormat::PNG},
+        {"jpeg", CropFormat::JPEG},
+        {"webp", CropFormat::WebP},
+        {"raw", CropFormat::Raw}
+    };
+
+    if (object.Has(formatKey)) {
+        Napi::Value format = object.Get(formatKey);
+        auto found = formats.find(format.IsString() ? format.As<Napi::String>().Utf8Value() : "");
+        if (format.IsBoolean()) {
+            encoding.format = format.As<Napi::Boolean>().Value() ? CropFormat::PNG : CropFormat::None;
+        } else if (found != formats.end()) {
+            encoding.format = found->second;
         } else {
-            Napi::TypeError::New(env, "Expected string or buffer argument").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+            Napi::TypeError::New(env, std::string(formatKey) + " must be a boolean, 'png', 'jpeg', 'webp' or 'raw'")
+                .ThrowAsJavaScriptException();
+            return false;
         }
+    }
 
-        if (image.empty()) {
-            Napi::Error::New(env, "Failed to read image").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+    if (object.Has(qualityKey)) {
+        Napi::Value quality = object.Get(qualityKey);
+        double value = quality.IsNumber() ? quality.As<Napi::Number>().DoubleValue() : -1;
+        if (!(value >= 0 && value <= 100)) {
+            Napi::TypeError::New(env, std::string(qualityKey) + " must be a number from 0 to 100").ThrowAsJavaScriptException();
+            return false;
         }
+        encoding.quality = static_cast<int>(value);
+    }
 
-        // Initialize QR code detector
-        cv::QRCodeDetector qrDecoder;
-        
-        // Try to detect and decode QR code
-        std::vector<cv::Point> points;
-        std::string decodedData = qrDecoder.detectAndDecode(image, points);
-        
-        // If not detected, try multiple preprocessing approaches
-        if (decodedData.empty()) {
-            cv::Mat gray;
-            if (image.channels() == 3) {
-                cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
-            } else {
-                gray = image.clone();
-            }
-            
-            // Method 1: Contrast enhancement with CLAHE
-            if (decodedData.empty()) {
-                cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(3.0, cv::Size(8, 8));
-                cv::Mat enhanced;
-                clahe->apply(gray, enhanced);
-                decodedData = qrDecoder.detectAndDecode(enhanced, points);
-            }
-            
-            // Method 2: Adaptive thresholding (multiple block sizes)
-            if (decodedData.empty()) {
-                for (int blockSize : {11, 15, 21, 31, 51}) {
-                    cv::Mat binary;
-                    cv::adaptiveThreshold(gray, binary, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
-                                        cv::THRESH_BINARY, blockSize, 2);
-                    decodedData = qrDecoder.detectAndDecode(binary, points);
-                    if (!decodedData.empty()) break;
+    if (object.Has(compressionKey)) {
+        Napi::Value compression = object.Get(compressionKey);
+        double value = compression.IsNumber() ? compression.As<Napi::Number>().DoubleValue() : -1;
+        if (!(value >= 0 && value <= 9)) {
+            Napi::TypeError::New(env, std::string(compressionKey) + " must be a number from 0 to 9").ThrowAsJavaScriptException();
+            return false;
+        }
+        encoding.compression = static_cast<int>(value);
+    }
+
+    if (object.Has(bufferKey)) {
+        Napi::Value buffer = object.Get(bufferKey);
+        if (!buffer.IsBoolean()) {
+            Napi::TypeError::New(env, std::string(bufferKey) + " must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        encoding.buffer = buffer.As<Napi::Boolean>().Value();
+    }
+    return true;
+}
+
+// Helper function to read an op parameter given as a number or an array of numbers.
+// values keeps its defaults when the parameter is absent.
+static bool GetOpNumbers(Napi::Env env, Napi::Object op, const char* key, double min, double max,
+                         bool odd, std::vector<double>& values) {
+    if (!op.Has(key)) {
+        return true;
+    }
+
+    Napi::Value value = op.Get(key);
+    std::vector<Napi::Value> items;
+    if (value.IsArray()) {
+        Napi::Array array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            items.push_back(array.Get(i));
+        }
+    } else {
+        items.push_back(value);
+    }
+
+    values.clear();
+    for (const Napi::Value& item : items) {
+        double number = item.IsNumber() ? item.As<Napi::Number>().DoubleValue() : -1;
+        bool valid = number >= min && number <= max &&
+            (!odd || (number == static_cast<int>(number) && static_cast<int>(number) % 2 == 1));
+        if (!valid) {
+            std::string message = std::string(key) + " must be " + (odd ? "odd numbers" : "numbers") +
+                cv::format(" from %g to %g", min, max);
+            Napi::TypeError::New(env, message).ThrowAsJavaScriptException();
+            return false;
+        }
+        values.push_back(number);
+    }
+    if (values.empty()) {
+        Napi::TypeError::New(env, std::string(key) + " must not be empty").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// Helper function to parse one pipeline op; block, clip and values lists expand
+// to one op per entry
+static bool ParsePipelineOp(Napi::Env env, Napi::Value value, std::vector<PipelineOp>& ops) {
+    static const std::map<std::string, PipelineOp::Kind> kinds = {
+        {"clahe", PipelineOp::Clahe},
+        {"adaptive", PipelineOp::Adaptive},
+        {"otsu", PipelineOp::Otsu},
+        {"bilateral", PipelineOp::Bilateral},
+        {"morph-close", PipelineOp::MorphClose},
+        {"sharpen", PipelineOp::Sharpen},
+        {"resize", PipelineOp::Resize},
+        {"gamma", PipelineOp::Gamma},
+        {"equalize", PipelineOp::Equalize}
+    };
+
+    if (!value.IsObject() || value.IsArray()) {
+        Napi::TypeError::New(env, "pipeline ops must be objects").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Object object = value.As<Napi::Object>();
+    Napi::Value name = object.Get("op");
+    auto found = kinds.find(name.IsString() ? name.As<Napi::String>().Utf8Value() : "");
+    if (found == kinds.end()) {
+        Napi::TypeError::New(env, "op must be 'clahe', 'adaptive', 'otsu', 'bilateral', 'morph-close', "
+                                  "'sharpen', 'resize', 'gamma' or 'equalize'").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    PipelineOp op;
+    op.kind = found->second;
+    std::vector<double> values = {0};
+    bool valid = true;
+    switch (op.kind) {
+        case PipelineOp::Clahe:
+            values = {3.0};
+            valid = GetOpNumbers(env, object, "clip", 0.1, 40, false, values);
+            break;
+        case PipelineOp::Adaptive:
+            values = {11};
+            valid = GetOpNumbers(env, object, "block", 3, 181, true, values);
+            break;
+        case PipelineOp::Otsu:
+            if (object.Has("inverted")) {
+                Napi::Value inverted = object.Get("inverted");
+                if (!inverted.IsBoolean()) {
+                    Napi::TypeError::New(env, "inverted must be a boolean").ThrowAsJavaScriptException();
+                    return false;
                 }
+                op.inverted = inverted.As<Napi::Boolean>().Value();
             }
-            
-            // Method 3: Otsu's thresholding
-            if (decodedData.empty()) {
-                cv::Mat binary;
-                cv::threshold(gray, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
-                decodedData = qrDecoder.detectAndDecode(binary, points);
+            break;
+        case PipelineOp::Bilateral: {
+            values = {9};
+            std::vector<double> sigma = {op.sigma};
+            valid = GetOpNumbers(env, object, "diameter", 1, 25, false, values) &&
+                GetOpNumbers(env, object, "sigma", 1, 300, false, sigma);
+            if (valid && sigma.size() != 1) {
+                Napi::TypeError::New(env, "sigma must be a single number").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 4: Inverted Otsu (for dark QR on light background)
-            if (decodedData.empty()) {
-                cv::Mat binary;
-                cv::threshold(gray, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
-                decodedData = qrDecoder.detectAndDecode(binary, points);
+            op.sigma = sigma[0];
+            break;
+        }
+        case PipelineOp::MorphClose:
+            values = {3};
+            valid = GetOpNumbers(env, object, "size", 1, 31, true, values);
+            break;
+        case PipelineOp::Resize:
+            values = {2.0};
+            valid = GetOpNumbers(env, object, "scale", 0.25, 4, false, values);
+            break;
+        case PipelineOp::Gamma:
+            values = {};
+            valid = GetOpNumbers(env, object, "values", kMinGamma, kMaxGamma, false, values);
+            if (valid && values.empty()) {
+                Napi::TypeError::New(env, "gamma needs values").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 5: Bilateral filter + adaptive threshold (noise reduction)
-            if (decodedData.empty()) {
-                cv::Mat filtered;
-                cv::bilateralFilter(gray, filtered, 9, 75, 75);
-                cv::Mat binary;
-                cv::adaptiveThreshold(filtered, binary, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
-                                    cv::THRESH_BINARY, 11, 2);
-                decodedData = qrDecoder.detectAndDecode(binary, points);
+            break;
+        case PipelineOp::Sharpen:
+        case PipelineOp::Equalize:
+            break;
+    }
+    if (!valid) {
+        return false;
+    }
+
+    for (double number : values) {
+        op.value = number;
+        ops.push_back(op);
+    }
+    return true;
+}
+
+// Helper function to parse a pipeline: an array of steps, each either an op
+// object or { ops: [...] } chaining several ops into one attempt. Steps may
+// also set name and onlyBelow.
+static bool ParsePipeline(Napi::Env env, Napi::Value value, std::shared_ptr<const Pipeline>& result) {
+    if (!value.IsArray()) {
+        Napi::TypeError::New(env, "pipeline must be an array of steps").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto pipeline = std::make_shared<Pipeline>();
+    Napi::Array steps = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < steps.Length(); i++) {
+        Napi::Value entry = steps.Get(i);
+        if (!entry.IsObject() || entry.IsArray()) {
+            Napi::TypeError::New(env, "pipeline steps must be objects").ThrowAsJavaScriptException();
+            return false;
+        }
+        Napi::Object object = entry.As<Napi::Object>();
+
+        PipelineStep step;
+        if (object.Has("name")) {
+            Napi::Value name = object.Get("name");
+            if (!name.IsString() || name.As<Napi::String>().Utf8Value().empty()) {
+                Napi::TypeError::New(env, "name must be a non-empty string").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 6: Morphological operations
-            if (decodedData.empty()) {
-                cv::Mat binary;
-                cv::threshold(gray, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
-                cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
-                cv::morphologyEx(binary, binary, cv::MORPH_CLOSE, kernel);
-                decodedData = qrDecoder.detectAndDecode(binary, points);
+            step.method = name.As<Napi::String>().Utf8Value();
+        }
+        if (object.Has("onlyBelow")) {
+            Napi::Value onlyBelow = object.Get("onlyBelow");
+            if (!onlyBelow.IsNumber() || onlyBelow.As<Napi::Number>().Int64Value() < 1) {
+                Napi::TypeError::New(env, "onlyBelow must be a positive number").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 7: Sharpen the image
-            if (decodedData.empty()) {
-                cv::Mat sharpened;
-                cv::Mat kernel = (cv::Mat_<float>(3,3) << 
-                    0, -1, 0,
-                    -1, 5, -1,
-                    0, -1, 0);
-                cv::filter2D(gray, sharpened, -1, kernel);
-                decodedData = qrDecoder.detectAndDecode(sharpened, points);
+            step.onlyBelow = static_cast<int>(std::min<int64_t>(onlyBelow.As<Napi::Number>().Int64Value(), 1 << 20));
+        }
+
+        std::vector<PipelineOp> ops;
+        if (object.Has("ops")) {
+            Napi::Value chain = object.Get("ops");
+            if (!chain.IsArray() || chain.As<Napi::Array>().Length() == 0) {
+                Napi::TypeError::New(env, "ops must be a non-empty array").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 8: Resize larger (for small QR codes)
-            if (decodedData.empty() && (gray.cols < 800 || gray.rows < 800)) {
-                cv::Mat resized;
-                cv::resize(gray, resized, cv::Size(), 2.0, 2.0, cv::INTER_CUBIC);
-                decodedData = qrDecoder.detectAndDecode(resized, points);
-                // Adjust points back to original scale
-                if (!decodedData.empty() && !points.empty()) {
-                    for (auto& point : points) {
-                        point.x /= 2.0;
-                        point.y /= 2.0;
-                    }
+            Napi::Array array = chain.As<Napi::Array>();
+            for (uint32_t j = 0; j < array.Length(); j++) {
+                size_t before = ops.size();
+                if (!ParsePipelineOp(env, array.Get(j), ops)) {
+                    return false;
                 }
-            }
-            
-            // Method 9: Gamma correction for low light images
-            if (decodedData.empty()) {
-                for (double gamma : {0.5, 0.7, 1.5, 2.0}) {
-                    cv::Mat lookUpTable(1, 256, CV_8U);
-                    uchar* p = lookUpTable.ptr();
-                    for(int i = 0; i < 256; ++i)
-                        p[i] = cv::saturate_cast<uchar>(pow(i / 255.0, gamma) * 255.0);
-                    
-                    cv::Mat corrected;
-                    cv::LUT(gray, lookUpTable, corrected);
-                    decodedData = qrDecoder.detectAndDecode(corrected, points);
-                    if (!decodedData.empty()) break;
+                if (ops.size() != before + 1) {
+                    Napi::TypeError::New(env, "chained ops take a single value per parameter").ThrowAsJavaScriptException();
+                    return false;
                 }
             }
-            
-            // Method 10: Histogram equalization
-            if (decodedData.empty()) {
-                cv::Mat equalized;
-                cv::equalizeHist(gray, equalized);
-                decodedData = qrDecoder.detectAndDecode(equalized, points);
+            step.ops = ops;
+            pipeline->push_back(step);
+        } else {
+            if (!ParsePipelineOp(env, object, ops)) {
+                return false;
             }
-            
-            // Method 11: Combination - CLAHE + Bilateral + Adaptive Threshold
-            if (decodedData.empty()) {
-                cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(4.0, cv::Size(8, 8));
-                cv::Mat enhanced;
-                clahe->apply(gray, enhanced);
-                
-                cv::Mat filtered;
-                cv::bilateralFilter(enhanced, filtered, 9, 75, 75);
-                
-                cv::Mat binary;
-                cv::adaptiveThreshold(filtered, binary, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
-                                    cv::THRESH_BINARY, 21, 2);
-                decodedData = qrDecoder.detectAndDecode(binary, points);
+            if (ops.size() > 1 && !step.method.empty()) {
+                Napi::TypeError::New(env, "name needs a single value per parameter").ThrowAsJavaScriptException();
+                return false;
             }
-            
-            // Method 12: Try on resized + enhanced version
-            if (decodedData.empty()) {
-                cv::Mat resized;
-                cv::resize(gray, resized, cv::Size(), 1.5, 1.5, cv::INTER_CUBIC);
-                
-                cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(3.0, cv::Size(8, 8));
-                cv::Mat enhanced;
-                clahe->apply(resized, enhanced);
-                
-                decodedData = qrDecoder.detectAndDecode(enhanced, points);
-                if (!decodedData.empty() && !points.empty()) {
-                    for (auto& point : points) {
-                        point.x /= 1.5;
-                        point.y /= 1.5;
-                    }
-                }
+            for (const PipelineOp& op : ops) {
+                step.ops = {op};
+                pipeline->push_back(step);
             }
         }
 
-        // Create result object
-        Napi::Object result = Napi::Object::New(env);
-        
-        if (!decodedData.empty()) {
-            // QR code detected and decoded successfully
-            result.Set("detected", Napi::Boolean::New(env, true));
-            result.Set("data", Napi::String::New(env, decodedData));
-            
-            // Add corner points if available
-            if (!points.empty()) {
-                Napi::Array cornersArray = Napi::Array::New(env, points.size());
-                for (size_t i = 0; i < points.size(); i++) {
-                    Napi::Object point = Napi::Object::New(env);
-                    point.Set("x", Napi::Number::New(env, points[i].x));
-                    point.Set("y", Napi::Number::New(env, points[i].y));
-                    cornersArray.Set(uint32_t(i), point);
-                }
-                result.Set("corners", cornersArray);
-                
-                // Extract the QR code region and encode as base64
-                if (points.size() >= 4) {
-                    // Get bounding rectangle
-                    cv::Rect boundingRect = cv::boundingRect(points);
-                    
-                    // Add padding
-                    int padding = 10;
-                    boundingRect.x = std::max(0, boundingRect.x - padding);
-                    boundingRect.y = std::max(0, boundingRect.y - padding);
-                    boundingRect.width = std::min(image.cols - boundingRect.x, boundingRect.width + 2 * padding);
-                    boundingRect.height = std::min(image.rows - boundingRect.y, boundingRect.height + 2 * padding);
-                    
-                    // Extract QR code region
-                    cv::Mat qrRegion = image(boundingRect);
-                    
-                    // Encode as PNG
-                    std::vector<uint8_t> buffer;
-                    std::vector<int> params = {cv::IMWRITE_PNG_COMPRESSION, 9};
-                    cv::imencode(".png", qrRegion, buffer, params);
-                    
-                    // Convert to base64
-                    std::string base64;
-                    static const char* base64_chars = 
-                        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                        "abcdefghijklmnopqrstuvwxyz"
-                        "0123456789+/";
-                    
-                    int i = 0;
-                    int j = 0;
-                    unsigned char char_array_3[3];
-                    unsigned char char_array_4[4];
-                    
-                    for (size_t idx = 0; idx < buffer.size(); idx++) {
-                        char_array_3[i++] = buffer[idx];
-                        if (i == 3) {
-                            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                            char_array_4[3] = char_array_3[2] & 0x3f;
-                            
-                            for(i = 0; i < 4; i++)
-                                base64 += base64_chars[char_array_4[i]];
-                            i = 0;
-                        }
-                    }
-                    
-                    if (i) {
-                        for(j = i; j < 3; j++)
-                            char_array_3[j] = '\0';
-                        
-                        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                        
-                        for (j = 0; j < i + 1; j++)
-                            base64 += base64_chars[char_array_4[j]];
-                        
-                        while(i++ < 3)
-                            base64 += '=';
-                    }
-                    
-                    result.Set("qrCodeImage", Napi::String::New(env, "data:image/png;base64," + base64));
-                }
+        if (pipeline->size() > kMaxPipelineSteps) {
+            Napi::TypeError::New(env, "pipeline expands to more than 64 steps").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    result = pipeline;
+    return true;
+}
+
+// Helper function to parse the optional options object that follows the image argument
+bool GetDetectOptions(const Napi::CallbackInfo& info, DetectOptions& options) {
+    Napi::Env env = info.Env();
+
+    {
+        GlobalPipeline& global = GlobalPipeline::Instance();
+        std::lock_guard<std::mutex> lock(global.mutex);
+        options.pipeline = global.pipeline;
+    }
+
+    if (info.Length() < 2 || info[1].IsUndefined() || info[1].IsNull()) {
+        return true;
+    }
+    if (!info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected options to be an object").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Object object = info[1].As<Napi::Object>();
+
+    if (object.Has("parallel")) {
+        Napi::Value parallel = object.Get("parallel");
+        if (!parallel.IsBoolean()) {
+            Napi::TypeError::New(env, "parallel must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.parallel = parallel.As<Napi::Boolean>().Value();
+    }
+
+    if (object.Has("order")) {
+        Napi::Value order = object.Get("order");
+        std::string name = order.IsString() ? order.As<Napi::String>().Utf8Value() : "";
+        if (name == "adaptive") {
+            options.adaptiveOrder = true;
+        } else if (name == "fixed") {
+            options.adaptiveOrder = false;
+        } else {
+            Napi::TypeError::New(env, "order must be 'adaptive' or 'fixed'").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (object.Has("timeoutMs")) {
+        Napi::Value timeoutMs = object.Get("timeoutMs");
+        if (!timeoutMs.IsNumber() || !std::isfinite(timeoutMs.As<Napi::Number>().DoubleValue()) ||
+            timeoutMs.As<Napi::Number>().DoubleValue() <= 0) {
+            Napi::TypeError::New(env, "timeoutMs must be a finite positive number").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.timeoutMs = timeoutMs.As<Napi::Number>().DoubleValue();
+    }
+
+    if (object.Has("maxAttempts")) {
+        Napi::Value maxAttempts = object.Get("maxAttempts");
+        if (!maxAttempts.IsNumber() || maxAttempts.As<Napi::Number>().Int64Value() < 1) {
+            Napi::TypeError::New(env, "maxAttempts must be a positive number").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.maxAttempts = static_cast<size_t>(maxAttempts.As<Napi::Number>().Int64Value());
+    }
+
+    if (object.Has("stats")) {
+        Napi::Value stats = object.Get("stats");
+        if (!stats.IsBoolean()) {
+            Napi::TypeError::New(env, "stats must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.stats = stats.As<Napi::Boolean>().Value();
+    }
+
+    if (object.Has("decode")) {
+        Napi::Value decode = object.Get("decode");
+        std::string name = decode.IsString() ? decode.As<Napi::String>().Utf8Value() : "";
+        if (name == "color") {
+            options.grayDecode = false;
+        } else if (name == "gray") {
+            options.grayDecode = true;
+        } else {
+            Napi::TypeError::New(env, "decode must be 'color' or 'gray'").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (object.Has("reduce")) {
+        Napi::Value reduce = object.Get("reduce");
+        int64_t factor = reduce.IsNumber() ? reduce.As<Napi::Number>().Int64Value() : 0;
+        if (factor != 1 && factor != 2 && factor != 4 && factor != 8) {
+            Napi::TypeError::New(env, "reduce must be 1, 2, 4 or 8").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.reduction = static_cast<int>(factor);
+    }
+
+    if (object.Has("pyramid")) {
+        Napi::Value pyramid = object.Get("pyramid");
+        int64_t factor = pyramid.IsNumber() ? pyramid.As<Napi::Number>().Int64Value() : -1;
+        if (factor != 0 && factor != 2 && factor != 4) {
+            Napi::TypeError::New(env, "pyramid must be 0, 2 or 4").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.pyramid = static_cast<int>(factor);
+    }
+
+    if (object.Has("tiles")) {
+        Napi::Value tiles = object.Get("tiles");
+        if (!tiles.IsBoolean()) {
+            Napi::TypeError::New(env, "tiles must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.tiled = tiles.As<Napi::Boolean>().Value();
+    }
+
+    if (object.Has("minCodeSize")) {
+        Napi::Value minCodeSize = object.Get("minCodeSize");
+        if (!minCodeSize.IsNumber() || minCodeSize.As<Napi::Number>().Int64Value() < 8) {
+            Napi::TypeError::New(env, "minCodeSize must be a number of at least 8").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.minCodeSize = static_cast<int>(std::min<int64_t>(minCodeSize.As<Napi::Number>().Int64Value(), 4096));
+    }
+
+    if (object.Has("gammas")) {
+        Napi::Value gammas = object.Get("gammas");
+        if (!gammas.IsArray() || gammas.As<Napi::Array>().Length() > 16) {
+            Napi::TypeError::New(env, "gammas must be an array of at most 16 numbers").ThrowAsJavaScriptException();
+            return false;
+        }
+        Napi::Array array = gammas.As<Napi::Array>();
+        options.gammas.clear();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            Napi::Value gamma = array.Get(i);
+            if (!gamma.IsNumber() || !IsValidGamma(gamma.As<Napi::Number>().DoubleValue())) {
+                Napi::TypeError::New(env, cv::format("gammas must be numbers from %g to %g", kMinGamma, kMaxGamma))
+                    .ThrowAsJavaScriptException();
+                return false;
             }
+            options.gammas.push_back(gamma.As<Napi::Number>().DoubleValue());
+        }
+    }
+
+    if (object.Has("threshold")) {
+        Napi::Value threshold = object.Get("threshold");
+        std::string name = threshold.IsString() ? threshold.As<Napi::String>().Utf8Value() : "";
+        if (name == "mean") {
+            options.gaussianThreshold = false;
+        } else if (name == "gaussian") {
+            options.gaussianThreshold = true;
         } else {
-            // No QR code detected
-            result.Set("detected", Napi::Boolean::New(env, false));
-            result.Set("data", env.Null());
+            Napi::TypeError::New(env, "threshold must be 'mean' or 'gaussian'").ThrowAsJavaScriptException();
+            return false;
         }
+    }
 
-        return result;
+    if (object.Has("localize")) {
+        Napi::Value localize = object.Get("localize");
+        if (!localize.IsBoolean()) {
+            Napi::TypeError::New(env, "localize must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.localize = localize.As<Napi::Boolean>().Value();
+    }
+
+    if (object.Has("rectify")) {
+        Napi::Value rectify = object.Get("rectify");
+        if (!rectify.IsBoolean()) {
+            Napi::TypeError::New(env, "rectify must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.rectify = rectify.As<Napi::Boolean>().Value();
+        options.localize = options.localize || options.rectify;
+    }
+
+    if (object.Has("pipeline")) {
+        Napi::Value pipeline = object.Get("pipeline");
+        if (pipeline.IsNull()) {
+            options.pipeline = nullptr;
+        } else if (!ParsePipeline(env, pipeline, options.pipeline)) {
+            return false;
+        }
+    }
+
+    if (object.Has("cropColor")) {
+        Napi::Value cropColor = object.Get("cropColor");
+        if (!cropColor.IsBoolean()) {
+            Napi::TypeError::New(env, "cropColor must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.cropColor = cropColor.As<Napi::Boolean>().Value();
+    }
+
+    if (!GetCropEncoding(env, object, "cropImage", "cropQuality", "cropCompression", "cropBuffer",
+                         options.crop)) {
+        return false;
+    }
+
+    if (object.Has("cropHandle")) {
+        Napi::Value cropHandle = object.Get("cropHandle");
+        if (!cropHandle.IsBoolean()) {
+            Napi::TypeError::New(env, "cropHandle must be a boolean").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.cropHandle = cropHandle.As<Napi::Boolean>().Value();
+    }
+
+    return true;
+}
+
+// Helper function to convert corner points to a JS array of {x, y}
+Napi::Array CornersToArray(Napi::Env env, const std::vector<cv::Point>& points) {
+    Napi::Array cornersArray = Napi::Array::New(env, points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        Napi::Object point = Napi::Object::New(env);
+        point.Set("x", Napi::Number::New(env, points[i].x));
+        point.Set("y", Napi::Number::New(env, points[i].y));
+        cornersArray.Set(uint32_t(i), point);
+    }
+    return cornersArray;
+}
+
+// Helper function to convert a crop region to { width, height, channels, data },
+// data holding the BGR or grayscale pixels row by row
+static Napi::Object RegionToObject(Napi::Env env, const cv::Mat& region) {
+    cv::Mat pixels = region.isContinuous() ? region : region.clone();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, pixels.cols));
+    result.Set("height", Napi::Number::New(env, pixels.rows));
+    result.Set("channels", Napi::Number::New(env, pixels.channels()));
+    result.Set("data", Napi::Buffer<uint8_t>::Copy(env, pixels.ptr<uint8_t>(), pixels.total() * pixels.elemSize()));
+    return result;
+}
+
+// Helper function to hand encoded crop bytes to JS without copying them. The
+// Buffer points into the vector, which lives until the Buffer is collected.
+// Runtimes that forbid external buffers (Electron with the V8 memory cage) get
+// a copy instead, and the vector is released right away.
+static Napi::Buffer<uint8_t> BytesToBuffer(Napi::Env env, const std::shared_ptr<std::vector<uint8_t>>& bytes) {
+    auto* owner = new std::shared_ptr<std::vector<uint8_t>>(bytes);
+    return Napi::Buffer<uint8_t>::NewOrCopy(env, bytes->data(), bytes->size(),
+        [](Napi::Env, uint8_t*, std::shared_ptr<std::vector<uint8_t>>* hint) {
+            delete hint;
+        }, owner);
+}
+
+// Helper function to add qrCodeImage and cropHandle to a code's result object
+static void AddQRCodeImage(Napi::Env env, Napi::Object target, const QRCodeResult& qrCode,
+                           const DetectOptions& options) {
+    if (options.crop.format == CropFormat::Raw && !qrCode.cropRegion.empty()) {
+        target.Set("qrCodeImage", RegionToObject(env, qrCode.cropRegion));
+    } else if (qrCode.qrCodeBytes && !qrCode.qrCodeBytes->empty()) {
+        target.Set("qrCodeImage", BytesToBuffer(env, qrCode.qrCodeBytes));
+    } else if (!qrCode.qrCodeImage.empty()) {
+        target.Set("qrCodeImage", Napi::String::New(env, qrCode.qrCodeImage));
+    }
+
+    if (options.cropHandle && !qrCode.cropRegion.empty()) {
+        cv::Mat* region = new cv::Mat(qrCode.cropRegion);
+        {
+            CropHandles& handles = CropHandles::Instance();
+            std::lock_guard<std::mutex> lock(handles.mutex);
+            handles.live.insert(region);
+        }
+        target.Set("cropHandle", Napi::External<cv::Mat>::New(env, region, [](Napi::Env, cv::Mat* region) {
+            CropHandles& handles = CropHandles::Instance();
+            {
+                std::lock_guard<std::mutex> lock(handles.mutex);
+                handles.live.erase(region);
+            }
+            delete region;
+        }));
+    }
+}
+
+// Helper function to convert per-stage timings to a JS object
+Napi::Object StatsToObject(Napi::Env env, const DetectionStats& stats) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("decodeMs", Napi::Number::New(env, stats.decodeMs));
+    result.Set("grayMs", Napi::Number::New(env, stats.grayMs));
+    result.Set("sharedMs", Napi::Number::New(env, stats.sharedMs));
+
+    Napi::Array methods = Napi::Array::New(env, stats.methods.size());
+    for (size_t i = 0; i < stats.methods.size(); i++) {
+        Napi::Object method = Napi::Object::New(env);
+        method.Set("method", Napi::String::New(env, stats.methods[i].method));
+        method.Set("ms", Napi::Number::New(env, stats.methods[i].ms));
+        method.Set("hit", Napi::Boolean::New(env, stats.methods[i].hit));
+        methods.Set(uint32_t(i), method);
+    }
+    result.Set("methods", methods);
+
+    result.Set("detectCalls", Napi::Number::New(env, stats.detectCalls));
+    if (stats.method.empty()) {
+        result.Set("method", env.Null());
+    } else {
+        result.Set("method", Napi::String::New(env, stats.method));
+    }
+    result.Set("cropMs", Napi::Number::New(env, stats.cropMs));
+    result.Set("encodeMs", Napi::Number::New(env, stats.encodeMs));
+    result.Set("base64Ms", Napi::Number::New(env, stats.base64Ms));
+    return result;
+}
+
+// Helper function to add the cascade report to a result object: timedOut and
+// methodsTried when a budget was set, stats when requested
+void AddReport(Napi::Env env, Napi::Object result, const DetectOptions& options,
+               const DetectionReport& report) {
+    if (options.timeoutMs > 0 || options.maxAttempts > 0) {
+        result.Set("timedOut", Napi::Boolean::New(env, report.timedOut));
+        Napi::Array methods = Napi::Array::New(env, report.methodsTried.size());
+        for (size_t i = 0; i < report.methodsTried.size(); i++) {
+            methods.Set(uint32_t(i), Napi::String::New(env, report.methodsTried[i]));
+        }
+        result.Set("methodsTried", methods);
+    }
+
+    if (options.stats) {
+        result.Set("stats", StatsToObject(env, report.stats));
+    }
+}
+
+// Build the detectQRCode() result object
+Napi::Object SingleResultToObject(Napi::Env env, bool detected, const QRCodeResult& qrCode,
+                                  const DetectOptions& options, const DetectionReport& report) {
+    Napi::Object result = Napi::Object::New(env);
+
+    if (detected) {
+        // QR code detected and decoded successfully
+        result.Set("detected", Napi::Boolean::New(env, true));
+        result.Set("data", Napi::String::New(env, qrCode.data));
+
+        // Add corner points if available
+        if (!qrCode.corners.empty()) {
+            result.Set("corners", CornersToArray(env, qrCode.corners));
+            AddQRCodeImage(env, result, qrCode, options);
+        }
+    } else {
+        // No QR code detected
+        result.Set("detected", Napi::Boolean::New(env, false));
+        result.Set("data", env.Null());
+    }
+
+    AddReport(env, result, options, report);
+    return result;
+}
+
+// Build the detectMultipleQRCodes() result object
+Napi::Object MultipleResultToObject(Napi::Env env, const std::vector<QRCodeResult>& qrCodes,
+                                    const DetectOptions& options, const DetectionReport& report) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("detected", Napi::Boolean::New(env, !qrCodes.empty()));
+    result.Set("count", Napi::Number::New(env, qrCodes.size()));
+
+    Napi::Array qrCodesArray = Napi::Array::New(env, qrCodes.size());
+    for (size_t i = 0; i < qrCodes.size(); i++) {
+        Napi::Object qrCode = Napi::Object::New(env);
+        qrCode.Set("data", Napi::String::New(env, qrCodes[i].data));
+
+        if (!qrCodes[i].corners.empty()) {
+            qrCode.Set("corners", CornersToArray(env, qrCodes[i].corners));
+            AddQRCodeImage(env, qrCode, qrCodes[i], options);
+        }
+
+        qrCodesArray.Set(uint32_t(i), qrCode);
+    }
+    result.Set("qrCodes", qrCodesArray);
+
+    AddReport(env, result, options, report);
+    return result;
+}
+
+// Build the hasQRCode() result object
+Napi::Object PresenceResultToObject(Napi::Env env, bool detected, const std::vector<cv::Point>& corners,
+                                    const DetectOptions& options, const DetectionReport& report) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("hasQRCode", Napi::Boolean::New(env, detected));
+
+    if (detected && !corners.empty()) {
+        result.Set("corners", CornersToArray(env, corners));
+    }
+
+    if (options.stats) {
+        result.Set("stats", StatsToObject(env, report.stats));
+    }
+    return result;
+}
+
+// Helper function to feed one finished call into the process-wide metrics
+static void RecordDetection(Operation op, bool detected, const DetectionReport& report,
+                            std::chrono::steady_clock::time_point start) {
+    const DetectionStats& stats = report.stats;
+    double detectMs = std::max(0.0, ElapsedMs(start) - stats.decodeMs);
+    Metrics::Instance().RecordCall(op, detected, report.timedOut, detectMs, stats.decodeMs,
+                                   stats.cropMs + stats.encodeMs + stats.base64Ms);
+}
+
+// Main QR code detection function
+Napi::Object DetectQRCode(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    try {
+        ImageSource source;
+        DetectOptions options;
+        if (!GetImageSource(info, source) || !GetDetectOptions(info, options)) {
+            return Napi::Object::New(env);
+        }
+
+        DetectionReport report;
+        auto start = std::chrono::steady_clock::now();
+        DecodedImage image = LoadImage(source, options, &report.stats);
+        if (image.pixels.empty()) {
+            Metrics::Instance().RecordError(Operation::DetectQRCode);
+            Napi::Error::New(env, "Failed to read image").ThrowAsJavaScriptException();
+            return Napi::Object::New(env);
+        }
+
+        QRCodeResult qrCode;
+        bool detected = DetectQRCodeInImage(image, options, qrCode, report);
+        RecordDetection(Operation::DetectQRCode, detected, report, start);
+        return SingleResultToObject(env, detected, qrCode, options, report);
     }
     catch (const std::exception& e) {
+        Metrics::Instance().RecordError(Operation::DetectQRCode);
         Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
         return Napi::Object::New(env);
     }
 }
 
 // Function to detect multiple QR codes in an image
-// Note: This uses detectAndDecode in a loop approach for better stability
 Napi::Object DetectMultipleQRCodes(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    cv::Mat image;
 
     try {
-        // Validate input
-        if (info.Length() < 1) {
-            Napi::TypeError::New(env, "Expected an image path or buffer").ThrowAsJavaScriptException();
+        ImageSource source;
+        DetectOptions options;
+        if (!GetImageSource(info, source) || !GetDetectOptions(info, options)) {
             return Napi::Object::New(env);
         }
 
-        // Read input image
-        if (info[0].IsString()) {
-            std::string imagePath = info[0].As<Napi::String>().Utf8Value();
-            image = cv::imread(imagePath, cv::IMREAD_COLOR);
-        } else if (info[0].IsBuffer()) {
-            Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
-            image = readImageFromBuffer(buffer);
-        } else {
-            Napi::TypeError::New(env, "Expected string or buffer argument").ThrowAsJavaScriptException();
+        DetectionReport report;
+        auto start = std::chrono::steady_clock::now();
+        DecodedImage image = LoadImage(source, options, &report.stats);
+        if (image.pixels.empty()) {
+            Metrics::Instance().RecordError(Operation::DetectMultipleQRCodes);
+            Napi::Error::New(env, "Failed to read image").ThrowAsJavaScriptException();
+            return Napi::Object::New(env);
+        }
+
+        std::vector<QRCodeResult> qrCodes = DetectMultipleQRCodesInImage(image, options, report);
+        RecordDetection(Operation::DetectMultipleQRCodes, !qrCodes.empty(), report, start);
+        return MultipleResultToObject(env, qrCodes, options, report);
+    }
+    catch (const std::exception& e) {
+        Metrics::Instance().RecordError(Operation::DetectMultipleQRCodes);
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return Napi::Object::New(env);
+    }
+}
+
+// Function to check if image contains a QR code (quick detection without decoding)
+Napi::Object HasQRCode(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    try {
+        ImageSource source;
+        DetectOptions options;
+        if (!GetImageSource(info, source) || !GetDetectOptions(info, options)) {
             return Napi::Object::New(env);
         }
 
-        if (image.empty()) {
+        DetectionReport report;
+        auto start = std::chrono::steady_clock::now();
+        DecodedImage image = LoadImage(source, options, &report.stats);
+        if (image.pixels.empty()) {
+            Metrics::Instance().RecordError(Operation::HasQRCode);
             Napi::Error::New(env, "Failed to read image").ThrowAsJavaScriptException();
             return Napi::Object::New(env);
         }
 
-        // Initialize QR code detector
-        cv::QRCodeDetector qrDecoder;
-        
-        // Try to detect and decode QR code
-        std::vector<cv::Point> points;
-        std::string decodedData = qrDecoder.detectAndDecode(image, points);
-        
-        // If not detected, try multiple preprocessing approaches (same as single detection)
-        if (decodedData.empty()) {
-            cv::Mat gray;
-            if (image.channels() == 3) {
-                cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        std::vector<cv::Point> corners;
+        bool detected = HasQRCodeInImage(image, options, corners, report);
+        RecordDetection(Operation::HasQRCode, detected, report, start);
+        return PresenceResultToObject(env, detected, corners, options, report);
+    }
+    catch (const std::exception& e) {
+        Metrics::Instance().RecordError(Operation::HasQRCode);
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return Napi::Object::New(env);
+    }
+}
+
+// Error code attached to promise rejections when the worker pool is full
+static const char* kOverloadedErrorCode = "ERR_QR_OVERLOADED";
+
+// Base class for the asynchronous entry points. Image decoding and detection
+// run in Execute() on a WorkerPool thread; the result is handed back to the JS
+// thread through a thread-safe function, and V8 is only touched in Complete().
+class DetectionJob {
+public:
+    DetectionJob(Napi::Env env, Napi::Object input, ImageSource source, const DetectOptions& options)
+        : deferred_(Napi::Promise::Deferred::New(env)),
+          options_(options),
+          source_(std::move(source)),
+          queuedAt_(std::chrono::steady_clock::now()) {
+        // source_ points into the input buffer, so pin it until the job is deleted
+        if (!input.IsEmpty()) {
+            input_ = Napi::Persistent(input);
+        }
+        completion_ = Napi::ThreadSafeFunction::New(
+            env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}),
+            "qr_code_detector", 0, 1);
+    }
+
+    virtual ~DetectionJob() = default;
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+    // Entry point the job is counted under in the metrics
+    virtual Operation GetOperation() const = 0;
+
+    // Runs on a pool thread
+    void Execute() {
+        Metrics::Instance().RecordQueueWait(ElapsedMs(queuedAt_));
+        auto start = std::chrono::steady_clock::now();
+        try {
+            DecodedImage image = LoadImage(source_, options_, &report_.stats);
+            if (image.pixels.empty()) {
+                error_ = "Failed to read image";
             } else {
-                gray = image.clone();
-            }
-            
-            // Try various preprocessing methods
-            std::vector<std::pair<std::string, cv::Mat>> preprocessedImages;
-            
-            // Method 1: CLAHE
-            cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(3.0, cv::Size(8, 8));
-            cv::Mat enhanced;
-            clahe->apply(gray, enhanced);
-            decodedData = qrDecoder.detectAndDecode(enhanced, points);
-            
-            // Method 2: Adaptive thresholding
-            if (decodedData.empty()) {
-                for (int blockSize : {11, 15, 21, 31, 51}) {
-                    cv::Mat binary;
-                    cv::adaptiveThreshold(gray, binary, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
-                                        cv::THRESH_BINARY, blockSize, 2);
-                    decodedData = qrDecoder.detectAndDecode(binary, points);
-                    if (!decodedData.empty()) break;
-                }
-            }
-            
-            // Method 3: Gamma correction
-            if (decodedData.empty()) {
-                for (double gamma : {0.5, 0.7, 1.5, 2.0}) {
-                    cv::Mat lookUpTable(1, 256, CV_8U);
-                    uchar* p = lookUpTable.ptr();
-                    for(int i = 0; i < 256; ++i)
-                        p[i] = cv::saturate_cast<uchar>(pow(i / 255.0, gamma) * 255.0);
-                    
-                    cv::Mat corrected;
-                    cv::LUT(gray, lookUpTable, corrected);
-                    decodedData = qrDecoder.detectAndDecode(corrected, points);
-                    if (!decodedData.empty()) break;
-                }
-            }
-            
-            // Method 4: Resize + enhance
-            if (decodedData.empty()) {
-                cv::Mat resized;
-                cv::resize(gray, resized, cv::Size(), 1.5, 1.5, cv::INTER_CUBIC);
-                
-                cv::Ptr<cv::CLAHE> clahe2 = cv::createCLAHE(3.0, cv::Size(8, 8));
-                cv::Mat enhanced2;
-                clahe2->apply(resized, enhanced2);
-                
-                decodedData = qrDecoder.detectAndDecode(enhanced2, points);
-                if (!decodedData.empty() && !points.empty()) {
-                    for (auto& point : points) {
-                        point.x /= 1.5;
-                        point.y /= 1.5;
-                    }
-                }
+                bool detected = Run(image);
+                RecordDetection(GetOperation(), detected, report_, start);
             }
         }
+        catch (const std::exception& e) {
+            error_ = e.what();
+        }
+        if (!error_.empty()) {
+            Metrics::Instance().RecordError(GetOperation());
+        }
 
-        // Create result object
-        Napi::Object result = Napi::Object::New(env);
-        
-        if (!decodedData.empty()) {
-            result.Set("detected", Napi::Boolean::New(env, true));
-            result.Set("count", Napi::Number::New(env, 1));
-            
-            // Create array with single QR code
-            Napi::Array qrCodesArray = Napi::Array::New(env, 1);
-            Napi::Object qrCode = Napi::Object::New(env);
-            qrCode.Set("data", Napi::String::New(env, decodedData));
-            
-            if (!points.empty()) {
-                Napi::Array cornersArray = Napi::Array::New(env, points.size());
-                for (size_t i = 0; i < points.size(); i++) {
-                    Napi::Object point = Napi::Object::New(env);
-                    point.Set("x", Napi::Number::New(env, points[i].x));
-                    point.Set("y", Napi::Number::New(env, points[i].y));
-                    cornersArray.Set(uint32_t(i), point);
-                }
-                qrCode.Set("corners", cornersArray);
-                
-                // Extract the QR code region and encode as base64
-                if (points.size() >= 4) {
-                    cv::Rect boundingRect = cv::boundingRect(points);
-                    int padding = 10;
-                    boundingRect.x = std::max(0, boundingRect.x - padding);
-                    boundingRect.y = std::max(0, boundingRect.y - padding);
-                    boundingRect.width = std::min(image.cols - boundingRect.x, boundingRect.width + 2 * padding);
-                    boundingRect.height = std::min(image.rows - boundingRect.y, boundingRect.height + 2 * padding);
-                    
-                    cv::Mat qrRegion = image(boundingRect);
-                    std::vector<uint8_t> buffer;
-                    std::vector<int> params = {cv::IMWRITE_PNG_COMPRESSION, 9};
-                    cv::imencode(".png", qrRegion, buffer, params);
-                    
-                    // Convert to base64
-                    std::string base64;
-                    static const char* base64_chars = 
-                        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                        "abcdefghijklmnopqrstuvwxyz"
-                        "0123456789+/";
-                    
-                    int i = 0;
-                    int j = 0;
-                    unsigned char char_array_3[3];
-                    unsigned char char_array_4[4];
-                    
-                    for (size_t idx = 0; idx < buffer.size(); idx++) {
-                        char_array_3[i++] = buffer[idx];
-                        if (i == 3) {
-                            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                            char_array_4[3] = char_array_3[2] & 0x3f;
-                            
-                            for(i = 0; i < 4; i++)
-                                base64 += base64_chars[char_array_4[i]];
-                            i = 0;
-                        }
-                    }
-                    
-                    if (i) {
-                        for(j = i; j < 3; j++)
-                            char_array_3[j] = '\0';
-                        
-                        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                        
-                        for (j = 0; j < i + 1; j++)
-                            base64 += base64_chars[char_array_4[j]];
-                        
-                        while(i++ < 3)
-                            base64 += '=';
-                    }
-                    
-                    qrCode.Set("qrCodeImage", Napi::String::New(env, "data:image/png;base64," + base64));
-                }
-            }
-            
-            qrCodesArray.Set(uint32_t(0), qrCode);
-            result.Set("qrCodes", qrCodesArray);
-        } else {
-            result.Set("detected", Napi::Boolean::New(env, false));
-            result.Set("count", Napi::Number::New(env, 0));
-            result.Set("qrCodes", Napi::Array::New(env, 0));
+        // The job is deleted on the JS thread, so keep our own copy of the handle
+        Napi::ThreadSafeFunction completion = completion_;
+        completion.BlockingCall(this, [](Napi::Env env, Napi::Function, DetectionJob* job) {
+            job->Complete(env);
+            delete job;
+        });
+        completion.Release();
+    }
+
+    // Runs on the JS thread when the pool refuses the job
+    void RejectOverloaded(Napi::Env env) {
+        RejectWithOverload(env);
+        completion_.Release();
+    }
+
+    // Runs on the pool's expiry thread when the job was parked by the 'wait'
+    // policy for longer than waitTimeoutMs; the rejection is handed to the JS thread
+    void Expire() {
+        Metrics::Instance().RecordRejected(GetOperation());
+        Napi::ThreadSafeFunction completion = completion_;
+        completion.BlockingCall(this, [](Napi::Env env, Napi::Function, DetectionJob* job) {
+            job->RejectWithOverload(env);
+            delete job;
+        });
+        completion.Release();
+    }
+
+protected:
+    // Runs on the pool thread with the decoded image, returns whether anything was found
+    virtual bool Run(const DecodedImage& image) = 0;
+
+    // Runs on the JS thread after a successful Run()
+    virtual void OnOK(Napi::Env env) = 0;
+
+    Napi::Promise::Deferred deferred_;
+    DetectOptions options_;
+    DetectionReport report_;
+
+private:
+    void RejectWithOverload(Napi::Env env) {
+        Napi::Error error = Napi::Error::New(env, "QR code detector is overloaded");
+        error.Value().Set("code", Napi::String::New(env, kOverloadedErrorCode));
+        deferred_.Reject(error.Value());
+    }
+
+    void Complete(Napi::Env env) {
+        if (!error_.empty()) {
+            deferred_.Reject(Napi::Error::New(env, error_).Value());
+            return;
         }
+        OnOK(env);
+    }
+
+    ImageSource source_;
+    Napi::ObjectReference input_;
+    std::chrono::steady_clock::time_point queuedAt_;
+    std::string error_;
+    Napi::ThreadSafeFunction completion_;
+};
 
-        return result;
+class DetectQRCodeJob : public DetectionJob {
+public:
+    using DetectionJob::DetectionJob;
+
+    Operation GetOperation() const override { return Operation::DetectQRCode; }
+
+protected:
+    bool Run(const DecodedImage& image) override {
+        detected_ = DetectQRCodeInImage(image, options_, qrCode_, report_);
+        return detected_;
     }
-    catch (const std::exception& e) {
-        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
-        return Napi::Object::New(env);
+
+    void OnOK(Napi::Env env) override {
+        deferred_.Resolve(SingleResultToObject(env, detected_, qrCode_, options_, report_));
     }
+
+private:
+    bool detected_ = false;
+    QRCodeResult qrCode_;
+};
+
+class DetectMultipleQRCodesJob : public DetectionJob {
+public:
+    using DetectionJob::DetectionJob;
+
+    Operation GetOperation() const override { return Operation::DetectMultipleQRCodes; }
+
+protected:
+    bool Run(const DecodedImage& image) override {
+        qrCodes_ = DetectMultipleQRCodesInImage(image, options_, report_);
+        return !qrCodes_.empty();
+    }
+
+    void OnOK(Napi::Env env) override {
+        deferred_.Resolve(MultipleResultToObject(env, qrCodes_, options_, report_));
+    }
+
+private:
+    std::vector<QRCodeResult> qrCodes_;
+};
+
+class HasQRCodeJob : public DetectionJob {
+public:
+    using DetectionJob::DetectionJob;
+
+    Operation GetOperation() const override { return Operation::HasQRCode; }
+
+protected:
+    bool Run(const DecodedImage& image) override {
+        detected_ = HasQRCodeInImage(image, options_, corners_, report_);
+        return detected_;
+    }
+
+    void OnOK(Napi::Env env) override {
+        deferred_.Resolve(PresenceResultToObject(env, detected_, corners_, options_, report_));
+    }
+
+private:
+    bool detected_ = false;
+    std::vector<cv::Point> corners_;
+};
+
+// Helper function to submit an asynchronous detection to the pool and return its promise
+template <typename Job>
+Napi::Value QueueDetection(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    ImageSource source;
+    DetectOptions options;
+    Napi::Object input;
+    if (!GetImageSource(info, source, &input) || !GetDetectOptions(info, options)) {
+        return env.Undefined();
+    }
+
+    Job* job = new Job(env, input, std::move(source), options);
+    Napi::Promise promise = job->GetPromise();
+    if (!WorkerPool::Instance().Submit([job] { job->Execute(); }, [job] { job->Expire(); })) {
+        Metrics::Instance().RecordRejected(job->GetOperation());
+        job->RejectOverloaded(env);
+        delete job;
+    }
+    return promise;
 }
 
-// Function to check if image contains a QR code (quick detection without decoding)
-Napi::Object HasQRCode(const Napi::CallbackInfo& info) {
+// configurePool({ threads, maxQueue, policy: 'reject' | 'wait', maxWaiting, waitTimeoutMs })
+Napi::Value ConfigurePool(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    cv::Mat image;
 
-    try {
-        // Validate input
-        if (info.Length() < 1) {
-            Napi::TypeError::New(env, "Expected an image path or buffer").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an options object").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object options = info[0].As<Napi::Object>();
+    WorkerPoolOptions poolOptions = WorkerPool::Instance().Options();
+
+    if (options.Has("threads")) {
+        Napi::Value threads = options.Get("threads");
+        if (!threads.IsNumber() || threads.As<Napi::Number>().Int64Value() < 1) {
+            Napi::TypeError::New(env, "threads must be a positive number").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
+        poolOptions.threads = static_cast<size_t>(threads.As<Napi::Number>().Int64Value());
+    }
 
-        // Read input image
-        if (info[0].IsString()) {
-            std::string imagePath = info[0].As<Napi::String>().Utf8Value();
-            image = cv::imread(imagePath, cv::IMREAD_COLOR);
-        } else if (info[0].IsBuffer()) {
-            Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
-            image = readImageFromBuffer(buffer);
+    if (options.Has("maxQueue")) {
+        Napi::Value maxQueue = options.Get("maxQueue");
+        if (!maxQueue.IsNumber() || maxQueue.As<Napi::Number>().Int64Value() < 1) {
+            Napi::TypeError::New(env, "maxQueue must be a positive number").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        poolOptions.maxQueue = static_cast<size_t>(maxQueue.As<Napi::Number>().Int64Value());
+    }
+
+    if (options.Has("policy")) {
+        Napi::Value policy = options.Get("policy");
+        std::string name = policy.IsString() ? policy.As<Napi::String>().Utf8Value() : "";
+        if (name == "reject") {
+            poolOptions.policy = OverflowPolicy::Reject;
+        } else if (name == "wait") {
+            poolOptions.policy = OverflowPolicy::Wait;
         } else {
-            Napi::TypeError::New(env, "Expected string or buffer argument").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+            Napi::TypeError::New(env, "policy must be 'reject' or 'wait'").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
+    }
 
-        if (image.empty()) {
-            Napi::Error::New(env, "Failed to read image").ThrowAsJavaScriptException();
-            return Napi::Object::New(env);
+    if (options.Has("maxWaiting")) {
+        Napi::Value maxWaiting = options.Get("maxWaiting");
+        if (!maxWaiting.IsNumber() || maxWaiting.As<Napi::Number>().Int64Value() < 0) {
+            Napi::TypeError::New(env, "maxWaiting must be a non-negative number").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
+        poolOptions.maxWaiting = static_cast<size_t>(maxWaiting.As<Napi::Number>().Int64Value());
+    }
 
-        // Initialize QR code detector
-        cv::QRCodeDetector qrDecoder;
-        
-        // Only detect, don't decode
-        std::vector<cv::Point> points;
-        bool detected = qrDecoder.detect(image, points);
-
-        // Create result object
-        Napi::Object result = Napi::Object::New(env);
-        result.Set("hasQRCode", Napi::Boolean::New(env, detected));
-        
-        if (detected && !points.empty()) {
-            Napi::Array cornersArray = Napi::Array::New(env, points.size());
-            for (size_t i = 0; i < points.size(); i++) {
-                Napi::Object point = Napi::Object::New(env);
-                point.Set("x", Napi::Number::New(env, points[i].x));
-                point.Set("y", Napi::Number::New(env, points[i].y));
-                cornersArray.Set(uint32_t(i), point);
+    if (options.Has("waitTimeoutMs")) {
+        Napi::Value waitTimeout = options.Get("waitTimeoutMs");
+        if (!waitTimeout.IsNumber() || waitTimeout.As<Napi::Number>().Int64Value() < 0) {
+            Napi::TypeError::New(env, "waitTimeoutMs must be a non-negative number").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        poolOptions.waitTimeoutMs = static_cast<uint32_t>(waitTimeout.As<Napi::Number>().Int64Value());
+    }
+
+    WorkerPool::Instance().Configure(poolOptions);
+    return env.Undefined();
+}
+
+// getPoolStats() -> { threads, maxQueue, maxWaiting, queued, waiting, active, completed, rejected }
+Napi::Value GetPoolStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    WorkerPoolStats stats = WorkerPool::Instance().Stats();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("threads", Napi::Number::New(env, stats.threads));
+    result.Set("maxQueue", Napi::Number::New(env, stats.maxQueue));
+    result.Set("maxWaiting", Napi::Number::New(env, stats.maxWaiting));
+    result.Set("queued", Napi::Number::New(env, stats.queued));
+    result.Set("waiting", Napi::Number::New(env, stats.waiting));
+    result.Set("active", Napi::Number::New(env, stats.active));
+    result.Set("completed", Napi::Number::New(env, stats.completed));
+    result.Set("rejected", Napi::Number::New(env, stats.rejected));
+    return result;
+}
+
+// getCascadeStats() -> { single: [{ method, attempts, hits, totalMs }], multiple: [...] }
+Napi::Value GetCascadeStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Object result = Napi::Object::New(env);
+
+    for (const auto& cascade : CascadeStats::Instance().Snapshot()) {
+        Napi::Array methods = Napi::Array::New(env, cascade.second.size());
+        for (size_t i = 0; i < cascade.second.size(); i++) {
+            const MethodStats& stats = cascade.second[i];
+            Napi::Object method = Napi::Object::New(env);
+            method.Set("method", Napi::String::New(env, stats.method));
+            method.Set("attempts", Napi::Number::New(env, static_cast<double>(stats.attempts)));
+            method.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+            method.Set("totalMs", Napi::Number::New(env, stats.totalMs));
+            methods.Set(uint32_t(i), method);
+        }
+        result.Set(cascade.first, methods);
+    }
+
+    return result;
+}
+
+// setCascadeStats(stats) replaces the counters, e.g. with a snapshot saved by a previous process
+Napi::Value SetCascadeStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected a stats object").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::map<std::string, std::vector<MethodStats>> snapshot;
+    Napi::Object object = info[0].As<Napi::Object>();
+    Napi::Array cascades = object.GetPropertyNames();
+    for (uint32_t i = 0; i < cascades.Length(); i++) {
+        std::string cascade = cascades.Get(i).As<Napi::String>().Utf8Value();
+        Napi::Value methods = object.Get(cascade);
+        if (!methods.IsArray()) {
+            Napi::TypeError::New(env, "Expected an array of method stats for " + cascade).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+
+        Napi::Array array = methods.As<Napi::Array>();
+        for (uint32_t j = 0; j < array.Length(); j++) {
+            Napi::Value entry = array.Get(j);
+            if (!entry.IsObject()) {
+                Napi::TypeError::New(env, "Expected method stats to be objects").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+
+            Napi::Object method = entry.As<Napi::Object>();
+            Napi::Value name = method.Get("method");
+            Napi::Value attempts = method.Get("attempts");
+            Napi::Value hits = method.Get("hits");
+            Napi::Value totalMs = method.Get("totalMs");
+            if (!name.IsString() || !attempts.IsNumber() || !hits.IsNumber() || !totalMs.IsNumber()) {
+                Napi::TypeError::New(env, "Method stats need method, attempts, hits and totalMs").ThrowAsJavaScriptException();
+                return env.Undefined();
             }
-            result.Set("corners", cornersArray);
+
+            MethodStats stats;
+            stats.method = name.As<Napi::String>().Utf8Value();
+            stats.attempts = static_cast<uint64_t>(std::max<int64_t>(0, attempts.As<Napi::Number>().Int64Value()));
+            stats.hits = static_cast<uint64_t>(std::max<int64_t>(0, hits.As<Napi::Number>().Int64Value()));
+            stats.totalMs = std::max(0.0, totalMs.As<Napi::Number>().DoubleValue());
+            // More hits than attempts would give the ordering a hit rate above 1
+            if (stats.hits > stats.attempts) {
+                Napi::TypeError::New(env, "Method stats cannot have more hits than attempts").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            snapshot[cascade].push_back(stats);
+        }
+    }
+
+    CascadeStats::Instance().Restore(snapshot);
+    return env.Undefined();
+}
+
+// resetCascadeStats() forgets all observed outcomes
+Napi::Value ResetCascadeStats(const Napi::CallbackInfo& info) {
+    CascadeStats::Instance().Reset();
+    return info.Env().Undefined();
+}
+
+// setPipeline(pipeline) sets the pipeline used when options don't name one; null restores the built-in cascades
+Napi::Value SetPipeline(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::shared_ptr<const Pipeline> pipeline;
+    if (info.Length() > 0 && !info[0].IsNull() && !info[0].IsUndefined() &&
+        !ParsePipeline(env, info[0], pipeline)) {
+        return env.Undefined();
+    }
+
+    GlobalPipeline& global = GlobalPipeline::Instance();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    global.pipeline = pipeline;
+    return env.Undefined();
+}
+
+// encodeQRCodeImage(cropHandle, { format, quality, compression, buffer }) -> the
+// crop kept by a detection as a data URL or Buffer, or as raw pixels for 'raw'
+Napi::Value EncodeCropHandle(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    cv::Mat region;
+    if (info.Length() > 0 && info[0].IsExternal()) {
+        const cv::Mat* handle = info[0].As<Napi::External<cv::Mat>>().Data();
+        CropHandles& handles = CropHandles::Instance();
+        std::lock_guard<std::mutex> lock(handles.mutex);
+        if (handles.live.count(handle)) {
+            region = *handle;
         }
+    }
+    if (region.empty()) {
+        Napi::TypeError::New(env, "Expected a cropHandle from a detection result").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
-        return result;
+    CropEncoding encoding;
+    encoding.format = CropFormat::PNG;
+    if (info.Length() > 1 && !info[1].IsUndefined()) {
+        if (!info[1].IsObject()) {
+            Napi::TypeError::New(env, "Expected options to be an object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!GetCropEncoding(env, info[1].As<Napi::Object>(), "format", "quality", "compression", "buffer",
+                             encoding)) {
+            return env.Undefined();
+        }
+    }
+
+    try {
+        if (encoding.format == CropFormat::Raw) {
+            return RegionToObject(env, region);
+        }
+        if (encoding.format == CropFormat::None) {
+            return env.Null();
+        }
+        if (encoding.buffer) {
+            auto bytes = std::make_shared<std::vector<uint8_t>>();
+            if (!EncodeQRCodeBytes(region, encoding, *bytes)) {
+                Napi::Error::New(env, "Failed to encode the crop").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            return BytesToBuffer(env, bytes);
+        }
+        return Napi::String::New(env, EncodeQRCodeImage(region, encoding));
     }
     catch (const std::exception& e) {
         Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
-        return Napi::Object::New(env);
+        return env.Undefined();
+    }
+}
+
+// getMetrics(format) -> process-wide counters and histograms as 'json' or 'prometheus' text
+Napi::Value GetMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::string format = "json";
+    if (info.Length() > 0 && !info[0].IsUndefined()) {
+        format = info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "";
     }
+    if (format == "json") {
+        return Napi::String::New(env, Metrics::Instance().ToJson());
+    }
+    if (format == "prometheus") {
+        return Napi::String::New(env, Metrics::Instance().ToPrometheus());
+    }
+    Napi::TypeError::New(env, "format must be 'json' or 'prometheus'").ThrowAsJavaScriptException();
+    return env.Undefined();
 }
 
 // Initialize the addon
@@ -555,8 +1376,55 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
         Napi::String::New(env, "hasQRCode"),
         Napi::Function::New(env, HasQRCode)
     );
+    exports.Set(
+        Napi::String::New(env, "detectQRCodeAsync"),
+        Napi::Function::New(env, QueueDetection<DetectQRCodeJob>)
+    );
+    exports.Set(
+        Napi::String::New(env, "detectMultipleQRCodesAsync"),
+        Napi::Function::New(env, QueueDetection<DetectMultipleQRCodesJob>)
+    );
+    exports.Set(
+        Napi::String::New(env, "hasQRCodeAsync"),
+        Napi::Function::New(env, QueueDetection<HasQRCodeJob>)
+    );
+    exports.Set(
+        Napi::String::New(env, "configurePool"),
+        Napi::Function::New(env, ConfigurePool)
+    );
+    exports.Set(
+        Napi::String::New(env, "getPoolStats"),
+        Napi::Function::New(env, GetPoolStats)
+    );
+    exports.Set(
+        Napi::String::New(env, "getCascadeStats"),
+        Napi::Function::New(env, GetCascadeStats)
+    );
+    exports.Set(
+        Napi::String::New(env, "setCascadeStats"),
+        Napi::Function::New(env, SetCascadeStats)
+    );
+    exports.Set(
+        Napi::String::New(env, "resetCascadeStats"),
+        Napi::Function::New(env, ResetCascadeStats)
+    );
+    exports.Set(
+        Napi::String::New(env, "setPipeline"),
+        Napi::Function::New(env, SetPipeline)
+    );
+    exports.Set(
+        Napi::String::New(env, "encodeQRCodeImage"),
+        Napi::Function::New(env, EncodeCropHandle)
+    );
+    exports.Set(
+        Napi::String::New(env, "getMetrics"),
+        Napi::Function::New(env, GetMetrics)
+    );
+    exports.Set(
+        Napi::String::New(env, "OVERLOADED_ERROR_CODE"),
+        Napi::String::New(env, kOverloadedErrorCode)
+    );
     return exports;
 }
 
 NODE_API_MODULE(qr_code_detector, Init)
-
@@ -0,0 +1,174 @@
+#include "worker_pool.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static size_t DefaultThreadCount() {
+    unsigned int cpus = std::thread::hardware_concurrency();
+    return cpus > 0 ? cpus : 4;
+}
+
+WorkerPool& WorkerPool::Instance() {
+    // Intentionally leaked: threads are detached and may still be parked on
+    // the condition variables while the process exits.
+    static WorkerPool* pool = new WorkerPool();
+    return *pool;
+}
+
+WorkerPool::WorkerPool() {
+    targetThreads_ = DefaultThreadCount();
+}
+
+void WorkerPool::Configure(const WorkerPoolOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    targetThreads_ = options.threads > 0 ? options.threads : DefaultThreadCount();
+
+    // Grow now if already running; surplus threads exit when they wake up
+    if (liveThreads_ > 0) {
+        StartThreadsLocked();
+    }
+    AdmitWaitingLocked();
+    hasWork_.notify_all();
+    hasWaiting_.notify_all();
+}
+
+WorkerPoolOptions WorkerPool::Options() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WorkerPoolOptions options = options_;
+    options.threads = targetThreads_;
+    return options;
+}
+
+WorkerPoolStats WorkerPool::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WorkerPoolStats stats;
+    stats.threads = targetThreads_;
+    stats.maxQueue = options_.maxQueue;
+    stats.maxWaiting = options_.maxWaiting;
+    stats.queued = queue_.size();
+    stats.waiting = waiting_.size();
+    stats.active = active_;
+    stats.completed = completed_;
+    stats.rejected = rejected_;
+    return stats;
+}
+
+bool WorkerPool::Submit(Task task, Task expire) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StartThreadsLocked();
+
+    // Parked tasks go first, so a new task waits behind them even if a slot is free
+    if (queue_.size() < options_.maxQueue && waiting_.empty()) {
+        queue_.push_back(std::move(task));
+        hasWork_.notify_one();
+        return true;
+    }
+    // Parked jobs pin their inputs, so the pending list is bounded too
+    if (options_.policy != OverflowPolicy::Wait || waiting_.size() >= options_.maxWaiting) {
+        rejected_++;
+        return false;
+    }
+
+    Waiting waiting;
+    waiting.task = std::move(task);
+    waiting.expire = std::move(expire);
+    waiting.hasDeadline = options_.waitTimeoutMs > 0;
+    if (waiting.hasDeadline) {
+        waiting.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.waitTimeoutMs);
+        if (!expiryStarted_) {
+            std::thread(&WorkerPool::ExpiryLoop, this).detach();
+            expiryStarted_ = true;
+        }
+    }
+    waiting_.push_back(std::move(waiting));
+    hasWaiting_.notify_one();
+    return true;
+}
+
+void WorkerPool::StartThreadsLocked() {
+    while (liveThreads_ < targetThreads_) {
+        std::thread(&WorkerPool::WorkerLoop, this).detach();
+        liveThreads_++;
+    }
+}
+
+void WorkerPool::AdmitWaitingLocked() {
+    while (!waiting_.empty() && queue_.size() < options_.maxQueue) {
+        queue_.push_back(std::move(waiting_.front().task));
+        waiting_.pop_front();
+        hasWork_.notify_one();
+    }
+}
+
+void WorkerPool::ExpiryLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // Deadlines are set at submit time, so the earliest is near the front;
+        // scanning them all keeps it right after waitTimeoutMs is lowered
+        bool hasDeadline = false;
+        std::chrono::steady_clock::time_point next;
+        for (const Waiting& waiting : waiting_) {
+            if (waiting.hasDeadline && (!hasDeadline || waiting.deadline < next)) {
+                next = waiting.deadline;
+                hasDeadline = true;
+            }
+        }
+        if (!hasDeadline) {
+            hasWaiting_.wait(lock);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < next) {
+            hasWaiting_.wait_until(lock, next);
+            continue;
+        }
+
+        std::vector<Task> expired;
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = waiting_.begin(); it != waiting_.end();) {
+            if (it->hasDeadline && it->deadline <= now) {
+                expired.push_back(std::move(it->expire));
+                it = waiting_.erase(it);
+                rejected_++;
+            } else {
+                ++it;
+            }
+        }
+
+        lock.unlock();
+        for (Task& expire : expired) {
+            if (expire) {
+                expire();
+            }
+        }
+        lock.lock();
+    }
+}
+
+void WorkerPool::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        hasWork_.wait(lock, [this] {
+            return !queue_.empty() || liveThreads_ > targetThreads_;
+        });
+
+        // Shrink after a Configure() with fewer threads
+        if (liveThreads_ > targetThreads_) {
+            liveThreads_--;
+            return;
+        }
+
+        Task task = std::move(queue_.front());
+        queue_.pop_front();
+        active_++;
+        AdmitWaitingLocked();
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        active_--;
+        completed_++;
+    }
+}
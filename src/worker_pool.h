@@ -0,0 +1,89 @@
+#ifndef QR_WORKER_POOL_H
+#define QR_WORKER_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// What Submit() does when the queue is full
+enum class OverflowPolicy {
+    Reject,     // fail immediately
+    Wait        // park the task until a slot frees up; the submitting thread never blocks
+};
+
+struct WorkerPoolOptions {
+    size_t threads = 0;                 // 0 = hardware concurrency
+    size_t maxQueue = 1024;             // jobs waiting for a thread
+    OverflowPolicy policy = OverflowPolicy::Reject;
+    size_t maxWaiting = 4096;           // Wait policy only: most tasks parked at once, beyond it they are rejected
+    uint32_t waitTimeoutMs = 0;         // Wait policy only: longest a task stays parked, 0 = no limit
+};
+
+struct WorkerPoolStats {
+    size_t threads = 0;
+    size_t maxQueue = 0;
+    size_t maxWaiting = 0;
+    size_t queued = 0;
+    size_t waiting = 0;                 // parked by the Wait policy until the queue has room
+    size_t active = 0;
+    uint64_t completed = 0;
+    uint64_t rejected = 0;
+};
+
+// Process-wide pool of native threads that runs detection jobs, so detection
+// does not compete with fs/crypto work on the libuv threadpool. Threads are
+// started lazily on first submit and can be resized at runtime.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    static WorkerPool& Instance();
+
+    void Configure(const WorkerPoolOptions& options);
+    WorkerPoolOptions Options() const;
+    WorkerPoolStats Stats() const;
+
+    // Queue a task. Returns false if the queue is full and the policy rejects,
+    // or with the Wait policy when maxWaiting tasks are already parked.
+    // Otherwise a Wait task that finds the queue full is parked and moves into
+    // the queue as slots free up; if waitTimeoutMs passes first, expire runs
+    // instead, on the pool's expiry thread.
+    bool Submit(Task task, Task expire);
+
+private:
+    WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // A task parked by the Wait policy
+    struct Waiting {
+        Task task;
+        Task expire;
+        bool hasDeadline;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void StartThreadsLocked();
+    void AdmitWaitingLocked();
+    void WorkerLoop();
+    void ExpiryLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable hasWork_;
+    std::condition_variable hasWaiting_;
+    std::deque<Task> queue_;
+    std::deque<Waiting> waiting_;
+    bool expiryStarted_ = false;
+    WorkerPoolOptions options_;
+    size_t targetThreads_ = 0;
+    size_t liveThreads_ = 0;
+    size_t active_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+#endif // QR_WORKER_POOL_H